@@ -4,11 +4,14 @@
 
 //#define OLC_SOUNDWAVE
 #include "olcSoundWaveEngine.h"
+#include "SimdLanes.h"
 #include <array>
 
 constexpr double pi = 3.14159265358979323846;
 
-class BiquadFilter : public olc::sound::synth::Module {
+//Ports are of sample type T, the coefficients and state are always double
+template<typename T>
+class BiquadFilter_generic : public olc::sound::synth::Module_generic<T> {
 public:
 	enum class Type {
 		LowPass,
@@ -20,23 +23,32 @@ public:
 		LowShelf,
 		HighShelf
 	};
-	BiquadFilter() : z0(0.9329157274413206), z1(-1.8658314548826411), z2(0.9329157274413206), p1(-1.7732296471466154), p2(0.9584332626186669) {};
+	BiquadFilter_generic() : z0(0.9329157274413206), z1(-1.8658314548826411), z2(0.9329157274413206), p1(-1.7732296471466154), p2(0.9584332626186669) {
+		RegisterPorts();
+	};
 	//{ 0.9329157274413206 , -1.8658314548826411 , 0.9329157274413206 , -1.7732296471466154, 0.9584332626186669 }
-	BiquadFilter(double z0_, double z1_, double z2_, double p1_, double p2_) : z0(z0_), z1(z1_), z2(z2_), p1(p1_), p2(p2_) {};
+	BiquadFilter_generic(double z0_, double z1_, double z2_, double p1_, double p2_) : z0(z0_), z1(z1_), z2(z2_), p1(p1_), p2(p2_) {
+		RegisterPorts();
+	};
 	double z0 = 0.0;
 	double z1 = 0.0;
 	double z2 = 0.0;
 	double p1 = 0.0;
 	double p2 = 0.0;
 
-	olc::sound::synth::Property input;
-	olc::sound::synth::Property output;
+	olc::sound::synth::Property_generic<T> input;
+	olc::sound::synth::Property_generic<T> output;
 
 	std::array<double, 2> i_state = {};
 	std::array<double, 2> o_state = {};
 
+	void RegisterPorts() {
+		this->RegisterInput(&input);
+		this->RegisterOutput(&output);
+	}
+
 	virtual void Update(uint32_t nChannel, double dTime, double dTimeStep) override {
-		double out = (input.value * z0) + (i_state[0] * z1) + (i_state[0] * z2) - (o_state[0] * p1) - (o_state[1] * p2);
+		double out = (input.value * z0) + (i_state[0] * z1) + (i_state[1] * z2) - (o_state[0] * p1) - (o_state[1] * p2);
 		o_state[1] = o_state[0];
 		i_state[1] = i_state[0];
 		o_state[0] = out;
@@ -45,11 +57,31 @@ public:
 		output.value = out;
 	}
 
-	//Maths from https://www.earlevel.com/main/2021/09/02/biquad-calculator-v3/
+	virtual void Reset() override {
+		i_state = {};
+		o_state = {};
+	}
+
 	void Configure(uint32_t nSampleRate, double Fc, double Q, double Gain, Type eType) {
+		std::array<double, 5> c = Design(nSampleRate, Fc, Q, Gain, eType);
+		z0 = c[0];
+		z1 = c[1];
+		z2 = c[2];
+		p1 = c[3];
+		p2 = c[4];
+	}
+
+	//z0, z1, z2, p1 and p2 for Configure, also used by BiquadBank and BiquadCascade
+	//Maths from https://www.earlevel.com/main/2021/09/02/biquad-calculator-v3/
+	static std::array<double, 5> Design(uint32_t nSampleRate, double Fc, double Q, double Gain, Type eType) {
 		double V = std::pow(10.0, std::abs(Gain) / 20);
 		double K = std::tan(pi * Fc / nSampleRate);
 		double N = 0.0;
+		double z0 = 0.0;
+		double z1 = 0.0;
+		double z2 = 0.0;
+		double p1 = 0.0;
+		double p2 = 0.0;
 
 
 		switch (eType) {
@@ -148,6 +180,209 @@ public:
 			}
 			break;
 		}
+		return { z0, z1, z2, p1, p2 };
+	}
+};
+
+using BiquadFilter = BiquadFilter_generic<olc::sound::synth::Sample>;
+
+//N biquads in parallel on one shared input, each with its own output.
+//The filters sit in the lanes of simd vectors and run the same arithmetic
+//as BiquadFilter, so each output matches a BiquadFilter with the same
+//coefficients exactly.
+template<typename T, size_t N>
+class BiquadBank_generic : public olc::sound::synth::Module_generic<T> {
+public:
+	using Property = olc::sound::synth::Property_generic<T>;
+	using Type = typename BiquadFilter_generic<T>::Type;
+
+	Property input;
+	std::array<Property, N> output;
+
+	BiquadBank_generic() {
+		this->RegisterInput(&input);
+		for (size_t i = 0; i < N; i++) {
+			this->RegisterOutput(&output[i]);
+		}
+	}
+
+	//Design filter i, see BiquadFilter::Configure
+	void Configure(size_t i, uint32_t nSampleRate, double Fc, double Q, double Gain, Type eType) {
+		std::array<double, 5> c = BiquadFilter_generic<T>::Design(nSampleRate, Fc, Q, Gain, eType);
+		z0[i] = c[0];
+		z1[i] = c[1];
+		z2[i] = c[2];
+		p1[i] = c[3];
+		p2[i] = c[4];
+	}
+
+	virtual void Reset() override {
+		o1 = {};
+		o2 = {};
+		i1 = 0.0;
+		i2 = 0.0;
+	}
+
+	virtual void Update(uint32_t nChannel, double dTime, double dTimeStep) override {
+		Process(&input.value, 1);
+		for (size_t i = 0; i < N; i++) {
+			output[i].value = static_cast<T>(y[0][i]);
+		}
+	}
+
+	virtual void ProcessBlock(uint32_t nChannel, double dStartTime, double dTimeStep, uint32_t nFrames) override {
+		std::array<T, chunk> x;
+		for (uint32_t start = 0; start < nFrames; start += chunk) {
+			uint32_t frames = std::min<uint32_t>(chunk, nFrames - start);
+			for (uint32_t n = 0; n < frames; n++) {
+				x[n] = input[start + n];
+			}
+			Process(x.data(), frames);
+			for (size_t i = 0; i < N; i++) {
+				for (uint32_t n = 0; n < frames; n++) {
+					output[i].Write(start + n, static_cast<T>(y[n][i]));
+				}
+			}
+		}
+	}
+
+private:
+	static constexpr uint32_t chunk = 64;
+	static constexpr size_t groups = (N + simd::width - 1) / simd::width;
+	static constexpr size_t lanes = groups * simd::width;
+	using Lanes = std::array<double, lanes>;
+
+	alignas(32) Lanes z0 = {};
+	alignas(32) Lanes z1 = {};
+	alignas(32) Lanes z2 = {};
+	alignas(32) Lanes p1 = {};
+	alignas(32) Lanes p2 = {};
+	alignas(32) Lanes o1 = {};
+	alignas(32) Lanes o2 = {};
+	//The input history is the same for every filter
+	double i1 = 0.0;
+	double i2 = 0.0;
+
+	//Outputs of the frames being processed, by frame then filter
+	alignas(32) std::array<Lanes, chunk> y = {};
+
+	void Process(const T* x, uint32_t frames) {
+		using namespace simd;
+		//Every group of filters steps through the frame together, so while
+		//one waits on its last output the others have work to do
+		Lane y1[groups];
+		Lane y2[groups];
+		for (size_t g = 0; g < groups; g++) {
+			y1[g] = Load(&o1[g * width]);
+			y2[g] = Load(&o2[g * width]);
+		}
+		Lane x1 = Set(i1);
+		Lane x2 = Set(i2);
+		for (uint32_t n = 0; n < frames; n++) {
+			Lane x0 = Set(x[n]);
+			for (size_t g = 0; g < groups; g++) {
+				const size_t v = g * width;
+				Lane out = Sub(Sub(Add(Add(Mul(x0, Load(&z0[v])), Mul(x1, Load(&z1[v]))), Mul(x2, Load(&z2[v]))), Mul(y1[g], Load(&p1[v]))), Mul(y2[g], Load(&p2[v])));
+				y2[g] = y1[g];
+				y1[g] = out;
+				Store(&y[n][v], out);
+			}
+			x2 = x1;
+			x1 = x0;
+		}
+		for (size_t g = 0; g < groups; g++) {
+			Store(&o1[g * width], y1[g]);
+			Store(&o2[g * width], y2[g]);
+		}
+
+		if (frames > 1) i2 = x[frames - 2];
+		else i2 = i1;
+		i1 = x[frames - 1];
+	}
+};
+
+template<size_t N>
+using BiquadBank = BiquadBank_generic<olc::sound::synth::Sample, N>;
+
+//N biquad sections in series, in transposed direct form II.  A block runs
+//through one section at a time so each keeps its state in registers.
+template<typename T, size_t N>
+class BiquadCascade_generic : public olc::sound::synth::Module_generic<T> {
+public:
+	using Property = olc::sound::synth::Property_generic<T>;
+	using Type = typename BiquadFilter_generic<T>::Type;
+
+	Property input;
+	Property output;
+
+	BiquadCascade_generic() {
+		for (auto& c : coefficients) {
+			//Pass through until configured
+			c = { 1.0, 0.0, 0.0, 0.0, 0.0 };
+		}
+		this->RegisterInput(&input);
+		this->RegisterOutput(&output);
+	}
+
+	//Design section i, see BiquadFilter::Configure
+	void Configure(size_t i, uint32_t nSampleRate, double Fc, double Q, double Gain, Type eType) {
+		coefficients[i] = BiquadFilter_generic<T>::Design(nSampleRate, Fc, Q, Gain, eType);
+	}
+
+	virtual void Reset() override {
+		state = {};
+	}
+
+	virtual void Update(uint32_t nChannel, double dTime, double dTimeStep) override {
+		double x = input.value;
+		for (size_t s = 0; s < N; s++) {
+			x = Section(s, x);
+		}
+		output.value = static_cast<T>(x);
+	}
+
+	virtual void ProcessBlock(uint32_t nChannel, double dStartTime, double dTimeStep, uint32_t nFrames) override {
+		std::array<double, chunk> x;
+		for (uint32_t start = 0; start < nFrames; start += chunk) {
+			uint32_t frames = std::min<uint32_t>(chunk, nFrames - start);
+			for (uint32_t n = 0; n < frames; n++) {
+				x[n] = input[start + n];
+			}
+			for (size_t s = 0; s < N; s++) {
+				const auto& c = coefficients[s];
+				double s1 = state[s][0];
+				double s2 = state[s][1];
+				for (uint32_t n = 0; n < frames; n++) {
+					double in = x[n];
+					double out = c[0] * in + s1;
+					s1 = c[1] * in - c[3] * out + s2;
+					s2 = c[2] * in - c[4] * out;
+					x[n] = out;
+				}
+				state[s] = { s1, s2 };
+			}
+			for (uint32_t n = 0; n < frames; n++) {
+				output.Write(start + n, static_cast<T>(x[n]));
+			}
+		}
+	}
+
+private:
+	static constexpr uint32_t chunk = 64;
+
+	//z0, z1, z2, p1 and p2 of each section
+	std::array<std::array<double, 5>, N> coefficients;
+	std::array<std::array<double, 2>, N> state = {};
+
+	double Section(size_t s, double in) {
+		const auto& c = coefficients[s];
+		double out = c[0] * in + state[s][0];
+		state[s][0] = c[1] * in - c[3] * out + state[s][1];
+		state[s][1] = c[2] * in - c[4] * out;
+		return out;
 	}
 };
 
+template<size_t N>
+using BiquadCascade = BiquadCascade_generic<olc::sound::synth::Sample, N>;
+
@@ -0,0 +1,200 @@
+#pragma once
+//Building blocks for FIR filtering: a dot product the compiler can vectorise,
+//a radix 2 FFT and a uniformly partitioned overlap-save convolver for
+//kernels too long to run directly.
+
+#include <complex>
+#include <cstddef>
+#include <vector>
+
+//a * b without the inf and nan recovery std::complex does, which keeps the
+//multiply inline
+template<typename T>
+inline std::complex<T> complex_mul(const std::complex<T>& a, const std::complex<T>& b) {
+	return { a.real() * b.real() - a.imag() * b.imag(), a.real() * b.imag() + a.imag() * b.real() };
+}
+
+//sum a[i] * b[i] for i < N.  The independent partial sums let the compiler
+//keep them in vector registers instead of one serial chain, 32 bytes of
+//them fills two SSE registers or one AVX register
+template<size_t N, typename T>
+inline T dot(const T* a, const T* b) {
+	constexpr size_t lanes = 32 / sizeof(T);
+	constexpr size_t whole = N - N % lanes;
+	T acc[lanes] = {};
+	for (size_t i = 0; i < whole; i += lanes) {
+		for (size_t j = 0; j < lanes; j++) {
+			acc[j] += a[i + j] * b[i + j];
+		}
+	}
+	for (size_t i = whole; i < N; i++) {
+		acc[0] += a[i] * b[i];
+	}
+
+	T out = 0;
+	for (size_t j = 0; j < lanes; j++) {
+		out += acc[j];
+	}
+	return out;
+}
+
+//In place complex FFT of a fixed power of two size
+template<typename T>
+class FFT {
+public:
+	explicit FFT(size_t size_ = 0) {
+		Resize(size_);
+	}
+
+	void Resize(size_t size_) {
+		size = size_;
+		bits = 0;
+		while ((size_t(1) << bits) < size) bits++;
+
+		reversed.resize(size);
+		for (size_t i = 0; i < size; i++) {
+			size_t r = 0;
+			for (size_t b = 0; b < bits; b++) {
+				r |= ((i >> b) & 1) << (bits - 1 - b);
+			}
+			reversed[i] = r;
+		}
+
+		twiddle.resize(size / 2);
+		for (size_t i = 0; i < size / 2; i++) {
+			double w = -2.0 * 3.14159265358979323846 * i / size;
+			twiddle[i] = std::complex<T>(T(std::cos(w)), T(std::sin(w)));
+		}
+	}
+
+	size_t Size() const {
+		return size;
+	}
+
+	//Unscaled, Forward then Inverse multiplies by Size()
+	void Forward(std::complex<T>* data) const {
+		Transform(data, false);
+	}
+
+	void Inverse(std::complex<T>* data) const {
+		Transform(data, true);
+	}
+
+private:
+	size_t size = 0;
+	size_t bits = 0;
+	std::vector<size_t> reversed;
+	std::vector<std::complex<T>> twiddle;
+
+	void Transform(std::complex<T>* data, bool inverse) const {
+		for (size_t i = 0; i < size; i++) {
+			if (i < reversed[i]) std::swap(data[i], data[reversed[i]]);
+		}
+
+		for (size_t len = 2; len <= size; len <<= 1) {
+			size_t half = len / 2;
+			size_t stride = size / len;
+			for (size_t start = 0; start < size; start += len) {
+				for (size_t k = 0; k < half; k++) {
+					std::complex<T> w = twiddle[k * stride];
+					if (inverse) w = std::conj(w);
+					std::complex<T> a = data[start + k];
+					std::complex<T> b = complex_mul(data[start + k + half], w);
+					data[start + k] = a + b;
+					data[start + k + half] = a - b;
+				}
+			}
+		}
+	}
+};
+
+//Convolves a stream with a long kernel, a block of partition samples at a
+//time, using FFTs of twice that size.  The kernel is cut into partitions of
+//the same length whose spectra are multiplied with those of the most recent
+//input blocks, so the cost per sample grows with the number of partitions
+//rather than with the kernel length.
+template<typename T>
+class PartitionedConvolver {
+public:
+	//Takes a copy of the kernel, call before processing
+	void Configure(const T* kernel, size_t taps, size_t partition_) {
+		partition = partition_;
+		bins = partition + 1;
+		partitions = (taps + partition - 1) / partition;
+		fft.Resize(2 * partition);
+
+		kernel_spectra.assign(partitions * bins, std::complex<T>());
+		std::vector<std::complex<T>> scratch(2 * partition);
+		for (size_t p = 0; p < partitions; p++) {
+			std::fill(scratch.begin(), scratch.end(), std::complex<T>());
+			for (size_t i = 0; i < partition && p * partition + i < taps; i++) {
+				scratch[i] = kernel[p * partition + i];
+			}
+			fft.Forward(scratch.data());
+			std::copy(scratch.begin(), scratch.begin() + bins, kernel_spectra.begin() + p * bins);
+		}
+
+		input_spectra.assign(partitions * bins, std::complex<T>());
+		window.assign(2 * partition, T(0));
+		spectrum.assign(2 * partition, std::complex<T>());
+		newest = 0;
+	}
+
+	//Forget all input so far
+	void Reset() {
+		std::fill(input_spectra.begin(), input_spectra.end(), std::complex<T>());
+		std::fill(window.begin(), window.end(), T(0));
+		newest = 0;
+	}
+
+	//Takes the next partition samples of input and writes the kernel's
+	//output for those same samples
+	void Process(const T* in, T* out) {
+		//Overlap-save: transform the previous block followed by this one
+		std::copy(window.begin() + partition, window.end(), window.begin());
+		std::copy(in, in + partition, window.begin() + partition);
+		for (size_t i = 0; i < 2 * partition; i++) {
+			spectrum[i] = window[i];
+		}
+		fft.Forward(spectrum.data());
+
+		//The input is real so the upper half of the spectrum is redundant
+		newest = (newest == 0 ? partitions : newest) - 1;
+		std::copy(spectrum.begin(), spectrum.begin() + bins, input_spectra.begin() + newest * bins);
+
+		//Partition p of the kernel meets the input from p blocks ago
+		std::fill(spectrum.begin(), spectrum.end(), std::complex<T>());
+		size_t slot = newest;
+		for (size_t p = 0; p < partitions; p++) {
+			const std::complex<T>* h = &kernel_spectra[p * bins];
+			const std::complex<T>* x = &input_spectra[slot * bins];
+			for (size_t k = 0; k < bins; k++) {
+				spectrum[k] += complex_mul(h[k], x[k]);
+			}
+			slot = (slot + 1 == partitions) ? 0 : slot + 1;
+		}
+		for (size_t k = 1; k < partition; k++) {
+			spectrum[2 * partition - k] = std::conj(spectrum[k]);
+		}
+		fft.Inverse(spectrum.data());
+
+		//The first half wrapped around, the second half is the linear convolution
+		const T scale = T(1) / T(2 * partition);
+		for (size_t i = 0; i < partition; i++) {
+			out[i] = spectrum[partition + i].real() * scale;
+		}
+	}
+
+private:
+	size_t partition = 0;
+	size_t bins = 0;
+	size_t partitions = 0;
+	size_t newest = 0;
+	FFT<T> fft;
+
+	std::vector<std::complex<T>> kernel_spectra;
+	//Spectra of the last partitions input blocks, newest first from slot newest
+	std::vector<std::complex<T>> input_spectra;
+	std::vector<T> window;
+	std::vector<std::complex<T>> spectrum;
+};
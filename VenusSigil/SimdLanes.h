@@ -0,0 +1,83 @@
+#pragma once
+//Minimal wrapper over the widest double precision vector the target supports.
+//Structure of arrays modules write their inner loops once against simd::Lane
+//and process simd::width voices per instruction: 4 with AVX, 2 with SSE2 and
+//1 (plain doubles) everywhere else, e.g. the default emscripten build.
+//Arrays passed to Load/Store must be aligned to 32 bytes.
+
+#include <cstddef>
+
+#if defined(__AVX__)
+#define VENUS_SIMD_AVX
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define VENUS_SIMD_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace simd {
+
+#if defined(VENUS_SIMD_AVX)
+	using Lane = __m256d;
+	using Mask = __m256d;
+	constexpr size_t width = 4;
+
+	inline Lane Load(const double* p) { return _mm256_load_pd(p); }
+	inline void Store(double* p, Lane a) { _mm256_store_pd(p, a); }
+	inline Lane Set(double f) { return _mm256_set1_pd(f); }
+	inline Lane Add(Lane a, Lane b) { return _mm256_add_pd(a, b); }
+	inline Lane Sub(Lane a, Lane b) { return _mm256_sub_pd(a, b); }
+	inline Lane Mul(Lane a, Lane b) { return _mm256_mul_pd(a, b); }
+	inline Lane Div(Lane a, Lane b) { return _mm256_div_pd(a, b); }
+	//Returns b if either is nan, like maxpd
+	inline Lane Max(Lane a, Lane b) { return _mm256_max_pd(a, b); }
+	inline Lane Min(Lane a, Lane b) { return _mm256_min_pd(a, b); }
+	inline Mask Less(Lane a, Lane b) { return _mm256_cmp_pd(a, b, _CMP_LT_OQ); }
+	inline Lane Select(Mask m, Lane a, Lane b) { return _mm256_blendv_pd(b, a, m); }
+	//Round each lane through float, to match code that passes doubles as float
+	inline Lane Narrow(Lane a) { return _mm256_cvtps_pd(_mm256_cvtpd_ps(a)); }
+	//(double)(1.0f - (float)a)
+	inline Lane NarrowComplement(Lane a) { return _mm256_cvtps_pd(_mm_sub_ps(_mm_set1_ps(1.0f), _mm256_cvtpd_ps(a))); }
+
+#elif defined(VENUS_SIMD_SSE2)
+	using Lane = __m128d;
+	using Mask = __m128d;
+	constexpr size_t width = 2;
+
+	inline Lane Load(const double* p) { return _mm_load_pd(p); }
+	inline void Store(double* p, Lane a) { _mm_store_pd(p, a); }
+	inline Lane Set(double f) { return _mm_set1_pd(f); }
+	inline Lane Add(Lane a, Lane b) { return _mm_add_pd(a, b); }
+	inline Lane Sub(Lane a, Lane b) { return _mm_sub_pd(a, b); }
+	inline Lane Mul(Lane a, Lane b) { return _mm_mul_pd(a, b); }
+	inline Lane Div(Lane a, Lane b) { return _mm_div_pd(a, b); }
+	inline Lane Max(Lane a, Lane b) { return _mm_max_pd(a, b); }
+	inline Lane Min(Lane a, Lane b) { return _mm_min_pd(a, b); }
+	inline Mask Less(Lane a, Lane b) { return _mm_cmplt_pd(a, b); }
+	inline Lane Select(Mask m, Lane a, Lane b) { return _mm_or_pd(_mm_and_pd(m, a), _mm_andnot_pd(m, b)); }
+	inline Lane Narrow(Lane a) { return _mm_cvtps_pd(_mm_cvtpd_ps(a)); }
+	inline Lane NarrowComplement(Lane a) { return _mm_cvtps_pd(_mm_sub_ps(_mm_set1_ps(1.0f), _mm_cvtpd_ps(a))); }
+
+#else
+	using Lane = double;
+	using Mask = bool;
+	constexpr size_t width = 1;
+
+	inline Lane Load(const double* p) { return *p; }
+	inline void Store(double* p, Lane a) { *p = a; }
+	inline Lane Set(double f) { return f; }
+	inline Lane Add(Lane a, Lane b) { return a + b; }
+	inline Lane Sub(Lane a, Lane b) { return a - b; }
+	inline Lane Mul(Lane a, Lane b) { return a * b; }
+	inline Lane Div(Lane a, Lane b) { return a / b; }
+	inline Lane Max(Lane a, Lane b) { return a > b ? a : b; }
+	inline Lane Min(Lane a, Lane b) { return a < b ? a : b; }
+	inline Mask Less(Lane a, Lane b) { return a < b; }
+	inline Lane Select(Mask m, Lane a, Lane b) { return m ? a : b; }
+	inline Lane Narrow(Lane a) { return static_cast<double>(static_cast<float>(a)); }
+	inline Lane NarrowComplement(Lane a) { return static_cast<double>(1.0f - static_cast<float>(a)); }
+#endif
+
+	//Clamp each lane to [lo, hi], nan becomes lo
+	inline Lane Clamp(Lane a, Lane lo, Lane hi) { return Min(Max(a, lo), hi); }
+}
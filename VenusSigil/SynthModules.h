@@ -0,0 +1,1842 @@
+#pragma once
+#include "olcSoundWaveEngine.h"
+#include "BiQuadFilter.h"
+#include "Convolution.h"
+#include "SimdLanes.h"
+
+#include <numeric>
+
+const uint32_t samplerate = 44100;
+
+
+template<typename T>
+[[nodiscard]] T lerp(const T& v0, const T& v1, float t) noexcept {
+	return v0 * (1.0f - t) + v1 * t;
+}
+//Map a value val that is between in_start and in_end to the range out_start out_end
+template<class T, class U>
+[[nodiscard]] U map(T in_start, T in_end, U out_start, U out_end, T val) noexcept {
+	auto t = std::clamp<U>((val - in_start) / (in_end - in_start), 0.0, 1.0);
+
+	return lerp(out_start, out_end, t);
+}
+
+//tan(pi * x) for 0 <= x < 0.5, e.g. tan_pi(Fc / Fs) for filter design.
+//A [5/4] Pade approximant on [0, pi/4], reflected as 1/tan(pi/2 - a) above that.
+//Worst case error is below 2e-5 cents of cutoff from 10 Hz to 22 kHz at 44.1 kHz
+inline double tan_pi(double x) {
+	bool reflect = x > 0.25;
+	double r = 3.14159265359 * (reflect ? 0.5 - x : x);
+	double r2 = r * r;
+	double t = r * (945.0 + r2 * (-105.0 + r2)) / (945.0 + r2 * (-420.0 + 15.0 * r2));
+	return reflect ? 1.0 / t : t;
+}
+
+inline float rand_float() {
+	return ((float)rand()) / RAND_MAX;
+}
+
+//class BiquadFilter : public olc::sound::synth::Module {
+//public:
+//	BiquadFilter() : z0(0.00005071144176722623), z1(0.00010142288353445246), z2(0.00005071144176722623), p1(-1.9983734580395864), p2(0.9985763038066554) {};
+//	//{ 0.9329157274413206 , -1.8658314548826411 , 0.9329157274413206 , -1.7732296471466154, 0.9584332626186669 }
+//	BiquadFilter(double z0_, double z1_, double z2_, double p1_, double p2_) : z0(z0_), z1(z1_), z2(z2_), p1(p1_), p2(p2_) {};
+//	double z0 = 0.0;
+//	double z1 = 0.0;
+//	double z2 = 0.0;
+//	double p1 = 0.0;
+//	double p2 = 0.0;
+//
+//	olc::sound::synth::Property input;
+//	olc::sound::synth::Property output;
+//
+//	std::array<double, 2> i_state = {};
+//	std::array<double, 2> o_state = {};
+//
+//	virtual void Update(uint32_t nChannel, double dTime, double dTimeStep) override {
+//		double out = (input.value * z0) + (i_state[0] * z1) + (i_state[0] * z2) - (o_state[0] * p1) - (o_state[1] * p2);
+//		o_state[1] = o_state[0];
+//		i_state[1] = i_state[0];
+//		o_state[0] = out;
+//		i_state[0] = input.value;
+//
+//		output.value = out;
+//	}
+//};
+
+//Every module takes the sample type T of its ports as its first template
+//parameter, the name without _generic uses olc::sound::synth::Sample.
+
+//A simple mixer with N inputs, the amplitudes are control rate
+template<typename T, size_t N>
+class Mixer_generic : public olc::sound::synth::Module_generic<T> {
+public:
+	using Property = olc::sound::synth::Property_generic<T>;
+
+	std::array<Property, N> inputs = {};
+	std::array<Property, N> amplitude = {};
+	Property output;
+
+	Mixer_generic() {
+		for (size_t i = 0; i < N; i++) {
+			amplitude[i].rate = Property::Rate::Control;
+			this->RegisterInput(&inputs[i]);
+			this->RegisterInput(&amplitude[i]);
+		}
+		this->RegisterOutput(&output);
+	}
+
+	virtual void Update(uint32_t nChannel, double dTime, double dTimeStep) override {
+		T out = 0.0f;
+
+		for (size_t i = 0; i < N; i++) {
+			out += amplitude[i].value * inputs[i].value;
+		}
+
+		output = out / N;
+	}
+
+	virtual void ProcessBlock(uint32_t nChannel, double dStartTime, double dTimeStep, uint32_t nFrames) override {
+		T gain[N];
+		for (size_t i = 0; i < N; i++) {
+			gain[i] = amplitude[i].value;
+		}
+
+		for (uint32_t n = 0; n < nFrames; n++) {
+			T out = 0.0;
+
+			for (size_t i = 0; i < N; i++) {
+				out += gain[i] * inputs[i][n];
+			}
+
+			output.Write(n, out / N);
+		}
+	}
+};
+
+template<size_t N>
+using Mixer = Mixer_generic<olc::sound::synth::Sample, N>;
+
+//Adds N inputs together, without the 1/N scaling of Mixer
+template<typename T, size_t N>
+class Sum_generic : public olc::sound::synth::Module_generic<T> {
+public:
+	using Property = olc::sound::synth::Property_generic<T>;
+
+	std::array<Property, N> inputs = {};
+	Property output;
+
+	Sum_generic() {
+		for (size_t i = 0; i < N; i++) {
+			this->RegisterInput(&inputs[i]);
+		}
+		this->RegisterOutput(&output);
+	}
+
+	virtual void Update(uint32_t nChannel, double dTime, double dTimeStep) override {
+		T out = 0.0;
+
+		for (size_t i = 0; i < N; i++) {
+			out += inputs[i].value;
+		}
+
+		output = out;
+	}
+
+	virtual void ProcessBlock(uint32_t nChannel, double dStartTime, double dTimeStep, uint32_t nFrames) override {
+		for (uint32_t n = 0; n < nFrames; n++) {
+			T out = 0.0;
+
+			for (size_t i = 0; i < N; i++) {
+				out += inputs[i][n];
+			}
+
+			output.Write(n, out);
+		}
+	}
+};
+
+template<size_t N>
+using Sum = Sum_generic<olc::sound::synth::Sample, N>;
+
+//Hard clips its input to [-ceiling, ceiling], nan becomes -ceiling.  Ports
+//never clamp what is written to them, so this is the one place a signal is
+//brought back into range, e.g. in front of the master output
+template<typename T>
+class Saturator_generic : public olc::sound::synth::Module_generic<T> {
+public:
+	using Property = olc::sound::synth::Property_generic<T>;
+
+	Property input = 0.0;
+	Property output = 0.0;
+	T ceiling = 1.0;
+
+	Saturator_generic() {
+		this->RegisterInput(&input);
+		this->RegisterOutput(&output);
+	}
+
+	virtual void Update(uint32_t nChannel, double dTime, double dTimeStep) override {
+		output = Clip(input.value, -ceiling, ceiling);
+	}
+
+	virtual void ProcessBlock(uint32_t nChannel, double dStartTime, double dTimeStep, uint32_t nFrames) override {
+		uint32_t n = 0;
+		if (input.buffer != nullptr && output.buffer != nullptr) {
+			//Whole chunks have a fixed trip count, which the compiler vectorises
+			for (; n + chunk <= nFrames; n += chunk) {
+				T x[chunk];
+				std::copy(input.buffer + n, input.buffer + n + chunk, x);
+				for (uint32_t i = 0; i < chunk; i++) {
+					x[i] = Clip(x[i], -ceiling, ceiling);
+				}
+				std::copy(x, x + chunk, output.buffer + n);
+			}
+			if (n > 0) {
+				output.value = output.buffer[n - 1];
+			}
+		}
+		for (; n < nFrames; n++) {
+			output.Write(n, Clip(input[n], -ceiling, ceiling));
+		}
+	}
+
+private:
+	static constexpr uint32_t chunk = 16;
+
+	//min(max(x, lo), hi) written the way minpd and maxpd behave
+	static T Clip(T x, T lo, T hi) {
+		x = lo < x ? x : lo;
+		return x < hi ? x : hi;
+	}
+};
+
+using Saturator = Saturator_generic<olc::sound::synth::Sample>;
+
+//Passes its input through, checking each block for nan and infinity.  A block
+//holding either comes out silent, every module given to Watch is Reset so the
+//graph recovers on the next block, and Events counts it.  Without it one nan
+//in a filter's state would keep the graph silent for good
+template<typename T>
+class NanGuard_generic : public olc::sound::synth::Module_generic<T> {
+public:
+	using Property = olc::sound::synth::Property_generic<T>;
+	using Module = olc::sound::synth::Module_generic<T>;
+
+	Property input = 0.0;
+	Property output = 0.0;
+
+	NanGuard_generic() {
+		this->RegisterInput(&input);
+		this->RegisterOutput(&output);
+	}
+
+	//Modules to Reset after a bad block, call before the synth runs.  Only
+	//watch modules that feed the guard, with threads anything else could
+	//still be running
+	void Watch(Module* module) {
+		watched.push_back(module);
+	}
+
+	//Bad blocks so far, safe to read from any thread
+	uint32_t Events() const {
+		return events.load(std::memory_order_relaxed);
+	}
+
+	virtual void Update(uint32_t nChannel, double dTime, double dTimeStep) override {
+		T x = input.value;
+		if (x - x != 0) {
+			Recover();
+			x = 0;
+		}
+		output = x;
+	}
+
+	virtual void ProcessBlock(uint32_t nChannel, double dStartTime, double dTimeStep, uint32_t nFrames) override {
+		//x - x is 0 unless x is nan or infinite, then the sum is nan
+		T check = 0;
+		for (uint32_t n = 0; n < nFrames; n++) {
+			T x = input[n];
+			check += x - x;
+			output.Write(n, x);
+		}
+
+		if (check != 0) {
+			Recover();
+			for (uint32_t n = 0; n < nFrames; n++) {
+				output.Write(n, 0);
+			}
+		}
+	}
+
+private:
+	std::vector<Module*> watched;
+	std::atomic<uint32_t> events{ 0 };
+
+	void Recover() {
+		for (Module* module : watched) {
+			module->Reset();
+		}
+		events.fetch_add(1, std::memory_order_relaxed);
+	}
+};
+
+using NanGuard = NanGuard_generic<olc::sound::synth::Sample>;
+
+//Delay line of up to max_seconds, sized when constructed or by SetMaxDelay.
+//delay is the fraction of the maximum to delay by and decay scales the input
+//as it is written.  Fractional delays are read with the chosen interpolation
+//and glide smooths changes of delay, so moving it does not click.  While the
+//delay holds still each block is written and read as at most two contiguous
+//spans of the buffer.
+template<typename T>
+class DelayLine_generic : public olc::sound::synth::Module_generic<T> {
+public:
+	using Property = olc::sound::synth::Property_generic<T>;
+
+	enum class Interpolation {
+		//Whole samples only, the delay is truncated
+		Truncate,
+		Linear,
+		//Third order Lagrange, delays below one sample are clamped to one
+		Lagrange,
+		//First order allpass, flat magnitude but delays below half a sample are clamped
+		AllPass
+	};
+
+	Property input = 0.0;
+	Property output = 0.0;
+	Property decay = 1.0;
+	Property delay = 1.0;
+
+	Interpolation interpolation = Interpolation::Linear;
+	//Time constant in seconds for the delay to follow a change, 0 jumps straight there
+	double glide = 0.0;
+
+	DelayLine_generic(double max_seconds = 1.0, uint32_t nSampleRate = samplerate) {
+		SetMaxDelay(max_seconds, nSampleRate);
+		this->RegisterInput(&input);
+		this->RegisterInput(&decay);
+		this->RegisterInput(&delay);
+		this->RegisterOutput(&output);
+	}
+
+	//Allocates and clears the buffer, call before the synth runs
+	void SetMaxDelay(double max_seconds, uint32_t nSampleRate) {
+		max_delay = std::max(0.0, max_seconds) * nSampleRate;
+		//Room for a whole chunk to be written before any of it is read
+		size = static_cast<size_t>(std::ceil(max_delay)) + chunk + guard + 1;
+		buffer.assign(size + guard, T(0));
+		Clear();
+	}
+
+	void Clear() {
+		std::fill(buffer.begin(), buffer.end(), T(0));
+		write_index = 0;
+		allpass_state = 0.0;
+		current = -1.0;
+	}
+
+	virtual void Reset() override {
+		Clear();
+	}
+
+	virtual void Update(uint32_t nChannel, double dTime, double dTimeStep) override {
+		Process(0, 1, dTimeStep, true, scratch.data());
+	}
+
+	virtual void ProcessBlock(uint32_t nChannel, double dStartTime, double dTimeStep, uint32_t nFrames) override {
+		for (uint32_t n = 0; n < nFrames; n += chunk) {
+			T* out = output.buffer != nullptr ? output.buffer + n : scratch.data();
+			Process(n, std::min<uint32_t>(chunk, nFrames - n), dTimeStep, false, out);
+		}
+	}
+
+private:
+	//Frames handled per pass, the buffer has this much slack beyond max_delay
+	static constexpr uint32_t chunk = 64;
+	//Samples mirrored past the end so interpolation never wraps mid span
+	static constexpr size_t guard = 3;
+
+	std::vector<T> buffer;
+	size_t size = 0;
+	size_t write_index = 0;
+	//In samples
+	double max_delay = 0.0;
+	//Delay in samples being read, it follows the target when gliding
+	double current = -1.0;
+	double allpass_state = 0.0;
+	std::array<T, chunk> scratch = {};
+
+	//Interpolation of a delay in samples: the newest sample used is this many
+	//back from the one being written, and the fraction and coefficients
+	struct Tap {
+		size_t back = 0;
+		double frac = 0.0;
+		std::array<double, 4> h = {};
+	};
+
+	//Delay in samples for a value of the delay property
+	double Target(double value) const {
+		double minimum = 0.0;
+		if (interpolation == Interpolation::Lagrange) minimum = 1.0;
+		if (interpolation == Interpolation::AllPass) minimum = 0.5;
+		return std::clamp(std::clamp(value, 0.0, 1.0) * max_delay, std::min(minimum, max_delay), max_delay);
+	}
+
+	Tap Prepare(double d) const {
+		Tap tap;
+		size_t whole = static_cast<size_t>(d);
+		double f = d - whole;
+		switch (interpolation) {
+		case Interpolation::Truncate:
+			tap.back = whole;
+			break;
+		case Interpolation::Linear:
+			//Reads x[n - whole - 1] and x[n - whole]
+			tap.back = whole + 1;
+			tap.h = { f, 1.0 - f };
+			break;
+		case Interpolation::Lagrange: {
+			//Reads x[n - whole - 2] to x[n - whole + 1], as a delay of 1 + f over the window
+			double D = 1.0 + f;
+			tap.back = whole + 2;
+			tap.h = {
+				D * (D - 1) * (D - 2) / 6,
+				-D * (D - 1) * (D - 3) / 2,
+				D * (D - 2) * (D - 3) / 2,
+				-(D - 1) * (D - 2) * (D - 3) / 6
+			};
+			break;
+		}
+		case Interpolation::AllPass:
+			//Keep the fraction in [0.5, 1.5), near 0 the pole sits on the unit circle
+			if (f < 0.5 && whole > 0) {
+				whole--;
+				f += 1.0;
+			}
+			tap.back = whole + 1;
+			tap.frac = (1.0 - f) / (1.0 + f);
+			break;
+		}
+		return tap;
+	}
+
+	//One output from window p, where p[tap.back] is the sample just written
+	T Read(const T* p, const Tap& tap) {
+		switch (interpolation) {
+		case Interpolation::Truncate:
+			return p[0];
+		case Interpolation::Linear:
+			return static_cast<T>(tap.h[0] * p[0] + tap.h[1] * p[1]);
+		case Interpolation::Lagrange:
+			return static_cast<T>(tap.h[0] * p[0] + tap.h[1] * p[1] + tap.h[2] * p[2] + tap.h[3] * p[3]);
+		case Interpolation::AllPass:
+			allpass_state = tap.frac * p[1] + p[0] - tap.frac * allpass_state;
+			return static_cast<T>(allpass_state);
+		}
+		return T(0);
+	}
+
+	//Read frames outputs with a fixed delay, as at most two spans
+	void ReadSpans(T* out, size_t start, uint32_t frames, const Tap& tap) {
+		uint32_t first = static_cast<uint32_t>(std::min<size_t>(frames, size - start));
+		const T* p = &buffer[start];
+		if (interpolation == Interpolation::Truncate) {
+			std::copy(p, p + first, out);
+			std::copy(buffer.data(), buffer.data() + (frames - first), out + first);
+			return;
+		}
+		if (interpolation == Interpolation::Linear) {
+			//Same double arithmetic as Read, so Update and ProcessBlock agree
+			const double h0 = tap.h[0];
+			const double h1 = tap.h[1];
+			for (uint32_t n = 0; n < first; n++) {
+				out[n] = static_cast<T>(h0 * p[n] + h1 * p[n + 1]);
+			}
+			p = buffer.data();
+			for (uint32_t n = first; n < frames; n++) {
+				out[n] = static_cast<T>(h0 * p[n - first] + h1 * p[n - first + 1]);
+			}
+			return;
+		}
+		for (uint32_t n = 0; n < first; n++) {
+			out[n] = Read(p + n, tap);
+		}
+		p = buffer.data();
+		for (uint32_t n = first; n < frames; n++) {
+			out[n] = Read(p + n - first, tap);
+		}
+	}
+
+	//Start of the read window for the frame written at w
+	size_t WindowStart(size_t w, size_t back) const {
+		return w >= back ? w - back : w + size - back;
+	}
+
+	//Runs frames frames from offset in the block into out.  single is a
+	//lone Update, which reads the ports' values rather than their buffers
+	void Process(uint32_t offset, uint32_t frames, double dTimeStep, bool single, T* out) {
+		auto in = [&](uint32_t n) {
+			return single ? input.value * decay.value : input[offset + n] * decay[offset + n];
+		};
+
+		//Write the whole chunk first, so delays shorter than it read its input
+		size_t w0 = write_index;
+		uint32_t first = static_cast<uint32_t>(std::min<size_t>(frames, size - w0));
+		for (uint32_t n = 0; n < first; n++) {
+			buffer[w0 + n] = in(n);
+		}
+		for (uint32_t n = first; n < frames; n++) {
+			buffer[n - first] = in(n);
+		}
+		for (size_t g = 0; g < guard; g++) {
+			buffer[size + g] = buffer[g];
+		}
+		write_index = w0 + frames >= size ? w0 + frames - size : w0 + frames;
+
+		double k = glide > 0.0 ? 1.0 - std::exp(-dTimeStep / glide) : 1.0;
+
+		double target = Target(single ? delay.value : delay[offset]);
+		if (current < 0.0) current = target;
+		if (std::abs(target - current) < 1e-4) current = target;
+
+		if (delay.buffer == nullptr && current == target) {
+			Tap tap = Prepare(current);
+			ReadSpans(out, WindowStart(w0, tap.back), frames, tap);
+		}
+		else {
+			for (uint32_t n = 0; n < frames; n++) {
+				target = Target(single ? delay.value : delay[offset + n]);
+				current += (target - current) * k;
+				Tap tap = Prepare(current);
+				size_t w = w0 + n >= size ? w0 + n - size : w0 + n;
+				out[n] = Read(&buffer[WindowStart(w, tap.back)], tap);
+			}
+		}
+
+		output.value = out[frames - 1];
+	}
+};
+
+using DelayLine = DelayLine_generic<olc::sound::synth::Sample>;
+
+//A simple DSP style first order filter, pole and zero are control rate
+template<typename T>
+class FirstOrderFilter_generic : public olc::sound::synth::Module_generic<T> {
+public:
+	using Property = olc::sound::synth::Property_generic<T>;
+
+	FirstOrderFilter_generic(double p, double z) : pole(p, Property::Rate::Control), zero(z, Property::Rate::Control) {
+		this->RegisterInput(&input);
+		this->RegisterInput(&pole);
+		this->RegisterInput(&zero);
+		this->RegisterOutput(&output);
+	};
+	Property pole;
+	Property zero;
+	T state = 0.0;
+	Property input = 0.0;
+	Property output = 0.0;
+	virtual void Reset() override {
+		state = 0.0;
+	}
+
+	virtual void Update(uint32_t nChannel, double dTime, double dTimeStep) override {
+		double new_state = input.value + pole.value * state;
+		output = new_state - zero.value * state;
+		state = new_state;
+	}
+};
+
+using FirstOrderFilter = FirstOrderFilter_generic<olc::sound::synth::Sample>;
+
+template<typename T>
+class Gain_generic : public olc::sound::synth::Module_generic<T> {
+private:
+	T max_gain = 6;
+public:
+	using Property = olc::sound::synth::Property_generic<T>;
+
+	Property gain = 1.0;
+	Property input = 0.0;
+	Property output = 0.0;
+
+	Gain_generic() {
+		this->RegisterInput(&gain);
+		this->RegisterInput(&input);
+		this->RegisterOutput(&output);
+	}
+
+	virtual void Update(uint32_t nChannel, double dTime, double dTimeStep) override {
+		output.value = max_gain * gain.value * input.value;
+	}
+
+	virtual void ProcessBlock(uint32_t nChannel, double dStartTime, double dTimeStep, uint32_t nFrames) override {
+		for (uint32_t n = 0; n < nFrames; n++) {
+			output.Write(n, max_gain * gain[n] * input[n]);
+		}
+	}
+};
+
+using Gain = Gain_generic<olc::sound::synth::Sample>;
+
+//FIR filter with NTaps taps, taps[0] applies to the newest input.
+//Short kernels run directly on a double length circular history, so no
+//samples move per frame.  Longer kernels run only their first partition
+//taps directly and the rest through a PartitionedConvolver, that part only
+//sees inputs at least a partition old so it adds no latency.
+template<typename T, size_t NTaps>
+class FIR_generic : public olc::sound::synth::Module_generic<T> {
+	static_assert(NTaps > 0, "FIR needs at least one tap");
+
+public:
+	using Property = olc::sound::synth::Property_generic<T>;
+
+	enum class Type {
+		LowPass,
+		HighPass
+	};
+
+	//Kernels longer than this use the partitioned convolution, around where
+	//it starts to win.  Twice as many floats fit in a vector
+	static constexpr size_t direct_limit = sizeof(T) <= sizeof(float) ? 512 : 256;
+	static constexpr size_t partition = 128;
+	static constexpr bool partitioned = NTaps > direct_limit;
+
+	Property input = 0.0;
+	Property output = 0.0;
+
+	FIR_generic() {
+		this->RegisterInput(&input);
+		this->RegisterOutput(&output);
+	}
+
+	//Replaces the kernel and clears the history, call before the synth runs
+	void SetTaps(const std::array<T, NTaps>& kernel) {
+		taps = kernel;
+		if constexpr (partitioned) {
+			tail.Configure(taps.data() + head, NTaps - head, partition);
+		}
+		Reset();
+	}
+
+	const std::array<T, NTaps>& Taps() const {
+		return taps;
+	}
+
+	//Blackman windowed sinc with unity gain in the pass band.
+	//HighPass is the spectral inverse of LowPass and needs an odd NTaps;
+	//an even length has no centre tap, so it is refused and the taps are left alone
+	bool Configure(uint32_t nSampleRate, double Fc, Type eType) {
+		if (eType == Type::HighPass && NTaps % 2 == 0) {
+			return false;
+		}
+
+		std::array<T, NTaps> kernel;
+		const double fc = Fc / nSampleRate;
+		const double m = static_cast<double>(NTaps - 1);
+		double sum = 0.0;
+		for (size_t i = 0; i < NTaps; i++) {
+			double n = i - m / 2.0;
+			double h = n == 0.0 ? 2.0 * fc : std::sin(2.0 * pi * fc * n) / (pi * n);
+			double w = NTaps == 1 ? 1.0 : 0.42 - 0.5 * std::cos(2.0 * pi * i / m) + 0.08 * std::cos(4.0 * pi * i / m);
+			kernel[i] = static_cast<T>(h * w);
+			sum += h * w;
+		}
+
+		for (auto& k : kernel) {
+			k = static_cast<T>(k / sum);
+		}
+
+		if (eType == Type::HighPass) {
+			for (auto& k : kernel) {
+				k = -k;
+			}
+			kernel[NTaps / 2] += 1;
+		}
+
+		SetTaps(kernel);
+		return true;
+	}
+
+	virtual void Reset() override {
+		history = {};
+		position = 0;
+		if constexpr (partitioned) {
+			tail.Reset();
+			block_in = {};
+			tail_out = {};
+			block_position = 0;
+		}
+	}
+
+	virtual void Update(uint32_t nChannel, double dTime, double dTimeStep) override {
+		output.value = Process(input.value);
+	}
+
+	virtual void ProcessBlock(uint32_t nChannel, double dStartTime, double dTimeStep, uint32_t nFrames) override {
+		for (uint32_t n = 0; n < nFrames; n++) {
+			output.Write(n, Process(input[n]));
+		}
+	}
+
+private:
+	//Taps run directly
+	static constexpr size_t head = partitioned ? partition : NTaps;
+	static constexpr size_t tail_block = partitioned ? partition : 1;
+
+	std::array<T, NTaps> taps = {};
+	//Every input is written twice, head apart, so the newest head inputs
+	//are always contiguous from position
+	std::array<T, 2 * head> history = {};
+	size_t position = 0;
+
+	//Only used when partitioned
+	PartitionedConvolver<T> tail;
+	std::array<T, tail_block> block_in = {};
+	std::array<T, tail_block> tail_out = {};
+	size_t block_position = 0;
+
+	T Process(T x) {
+		position = (position == 0 ? head : position) - 1;
+		history[position] = x;
+		history[position + head] = x;
+		T y = dot<head>(taps.data(), &history[position]);
+
+		if constexpr (partitioned) {
+			//tail_out holds the tail taps applied to the previous block, which
+			//is exactly this block delayed by the head
+			y += tail_out[block_position];
+			block_in[block_position] = x;
+			if (++block_position == partition) {
+				tail.Process(block_in.data(), tail_out.data());
+				block_position = 0;
+			}
+		}
+		return y;
+	}
+};
+
+template<size_t NTaps>
+using FIR = FIR_generic<olc::sound::synth::Sample, NTaps>;
+
+//Short fixed low pass
+template<typename T>
+class LPF_generic : public FIR_generic<T, 13> {
+public:
+	LPF_generic() {
+		std::array<T, 13> taps = { 0.000035,
+0.000928,
+0.004561,
+0.012669,
+0.024443,
+0.035453,
+0.040000,
+0.035453,
+0.024443,
+0.012669,
+0.004561,
+0.000928,
+0.000035 };
+		//The output is scaled by 2
+		for (auto& t : taps) {
+			t *= 2;
+		}
+		this->SetTaps(taps);
+	}
+};
+
+using LPF = LPF_generic<olc::sound::synth::Sample>;
+
+//Approximately filters white noise into pink noise
+template<typename T>
+class Pinkifier_generic : public olc::sound::synth::Module_generic<T> {
+	FirstOrderFilter_generic<T> f1 = { 0.99572754 , 0.98443604};
+	FirstOrderFilter_generic<T> f2 = { 0.94790649 , 0.83392334 };
+	FirstOrderFilter_generic<T> f3 = { 0.53567505 , 0.07568359 };
+
+public:
+	using Property = olc::sound::synth::Property_generic<T>;
+
+	Property input = 0.0f;
+	Property output = 0.0f;
+
+	Pinkifier_generic() {
+		this->RegisterInput(&input);
+		this->RegisterOutput(&output);
+	}
+
+	virtual void Reset() override {
+		f1.Reset();
+		f2.Reset();
+		f3.Reset();
+	}
+
+	virtual void Update(uint32_t nChannel, double dTime, double dTimeStep) override {
+		T x = Stage(input.value, f1.pole.value, f1.zero.value, f1.state);
+		x = Stage(x, f2.pole.value, f2.zero.value, f2.state);
+		output = Stage(x, f3.pole.value, f3.zero.value, f3.state);
+	}
+
+	//The same three stages with their state in locals
+	virtual void ProcessBlock(uint32_t nChannel, double dStartTime, double dTimeStep, uint32_t nFrames) override {
+		const T p1 = f1.pole.value, z1 = f1.zero.value;
+		const T p2 = f2.pole.value, z2 = f2.zero.value;
+		const T p3 = f3.pole.value, z3 = f3.zero.value;
+		T s1 = f1.state;
+		T s2 = f2.state;
+		T s3 = f3.state;
+		T x = 0;
+		for (uint32_t n = 0; n < nFrames; n++) {
+			x = Stage(input[n], p1, z1, s1);
+			x = Stage(x, p2, z2, s2);
+			x = Stage(x, p3, z3, s3);
+			output.Write(n, x);
+		}
+		f1.state = s1;
+		f2.state = s2;
+		f3.state = s3;
+	}
+
+private:
+	//FirstOrderFilter::Update, returns its output.  Output and state are
+	//saturated, the patch is voiced around these clamps
+	static T Stage(T in, T pole, T zero, T& state) {
+		double new_state = in + pole * state;
+		T out = std::clamp(T(new_state - zero * state), T(-1), T(1));
+		state = std::clamp(T(new_state), T(-1), T(1));
+		return out;
+	}
+};
+
+using Pinkifier = Pinkifier_generic<olc::sound::synth::Sample>;
+
+//Pink noise made directly rather than by filtering white noise from another
+//module.  Both algorithms give noise falling 3 dB per octave at about the
+//same level, within [-1, 1].
+//VossMcCartney sums 16 rows of held random values, row k changing every
+//2^(k+1) samples, plus a white one.
+//FilterBank is Paul Kellet's six parallel one pole filters, run across simd
+//lanes, the closer match to a -3 dB slope.  Its coefficients are for 44.1 kHz.
+template<typename T>
+class PinkNoise_generic : public olc::sound::synth::Module_generic<T> {
+public:
+	using Property = olc::sound::synth::Property_generic<T>;
+
+	enum class Algorithm {
+		VossMcCartney,
+		FilterBank
+	};
+
+	Algorithm algorithm = Algorithm::FilterBank;
+	Property amplitude = 1.0;
+	Property output;
+
+	PinkNoise_generic() {
+		this->RegisterInput(&amplitude);
+		this->RegisterOutput(&output);
+	}
+
+	//See NoiseGenerator::Seed, give each PinkNoise its own nStream
+	void Seed(uint32_t nSeed, uint32_t nStream = 0) {
+		noise.Seed(nSeed, nStream);
+	}
+
+	virtual void Update(uint32_t nChannel, double dTime, double dTimeStep) override {
+		T x = 0;
+		Process(&x, 1);
+		output = amplitude.value * x;
+	}
+
+	virtual void ProcessBlock(uint32_t nChannel, double dStartTime, double dTimeStep, uint32_t nFrames) override {
+		std::array<T, chunk> x;
+		for (uint32_t start = 0; start < nFrames; start += chunk) {
+			uint32_t frames = std::min<uint32_t>(chunk, nFrames - start);
+			Process(x.data(), frames);
+			for (uint32_t n = 0; n < frames; n++) {
+				output.Write(start + n, amplitude[start + n] * x[n]);
+			}
+		}
+	}
+
+private:
+	static constexpr uint32_t chunk = 64;
+	static constexpr size_t rows = 16;
+	static constexpr size_t filters = 6;
+	static constexpr size_t groups = (filters + simd::width - 1) / simd::width;
+	static constexpr size_t lanes = groups * simd::width;
+	using Lanes = std::array<double, lanes>;
+
+	static constexpr uint8_t trailing_zeros[32] = {
+		0, 1, 28, 2, 29, 14, 24, 3, 30, 22, 20, 15, 25, 17, 4, 8,
+		31, 27, 13, 23, 21, 19, 16, 7, 26, 12, 18, 6, 11, 5, 10, 9
+	};
+
+	olc::sound::synth::NoiseGenerator noise;
+	std::array<double, chunk * 2> white;
+
+	//VossMcCartney
+	std::array<double, rows> row = {};
+	double row_sum = 0.0;
+	uint32_t counter = 0;
+
+	//FilterBank, Kellet's gains scaled by 0.08 to match VossMcCartney's level
+	alignas(32) Lanes pole = { 0.99886, 0.99332, 0.96900, 0.86650, 0.55000, -0.7616 };
+	alignas(32) Lanes gain = { 0.0555179 * 0.08, 0.0750759 * 0.08, 0.1538520 * 0.08, 0.3104856 * 0.08, 0.5329522 * 0.08, -0.0168980 * 0.08 };
+	alignas(32) Lanes state = {};
+	alignas(32) std::array<Lanes, chunk> bank;
+	double delayed = 0.0;
+	static constexpr double direct_gain = 0.5362 * 0.08;
+	static constexpr double delayed_gain = 0.115926 * 0.08;
+
+	void Process(T* out, uint32_t frames) {
+		switch (algorithm) {
+		case Algorithm::VossMcCartney:
+			noise.FillUniform(white.data(), frames * 2);
+			for (uint32_t n = 0; n < frames; n++) {
+				//Row k changes when counter has k trailing zeros, found by a
+				//de Bruijn multiply of the lowest set bit rather than a loop
+				uint32_t c = ++counter;
+				size_t k = c == 0 ? 32 : trailing_zeros[((c & (0u - c)) * 0x077CB531u) >> 27];
+				if (k < rows) {
+					row_sum += white[n * 2] - row[k];
+					row[k] = white[n * 2];
+				}
+				else {
+					//Every 2^rows samples, add the rows up afresh so rounding never builds up
+					row_sum = std::accumulate(row.begin(), row.end(), 0.0);
+				}
+				out[n] = T((row_sum + white[n * 2 + 1]) / (rows + 1));
+			}
+			break;
+
+		case Algorithm::FilterBank: {
+			using namespace simd;
+			noise.FillUniform(white.data(), frames);
+			//The groups of filters step through each frame together so their
+			//recurrences overlap
+			Lane b[groups];
+			for (size_t g = 0; g < groups; g++) {
+				b[g] = Load(&state[g * width]);
+			}
+			for (uint32_t n = 0; n < frames; n++) {
+				const Lane w = Set(white[n]);
+				for (size_t g = 0; g < groups; g++) {
+					b[g] = Add(Mul(Load(&pole[g * width]), b[g]), Mul(Load(&gain[g * width]), w));
+					Store(&bank[n][g * width], b[g]);
+				}
+			}
+			for (size_t g = 0; g < groups; g++) {
+				Store(&state[g * width], b[g]);
+			}
+			for (uint32_t n = 0; n < frames; n++) {
+				//Summed as a tree, a chain of six adds would be the slowest part
+				const Lanes& y = bank[n];
+				double sum = ((y[0] + y[1]) + (y[2] + y[3])) + ((y[4] + y[5]) + (white[n] * direct_gain + delayed));
+				delayed = white[n] * delayed_gain;
+				out[n] = T(sum);
+			}
+			break;
+		}
+		}
+	}
+};
+
+using PinkNoise = PinkNoise_generic<olc::sound::synth::Sample>;
+
+//Attack, decay, sustain and release, applied to mInput.  Every segment is a
+//recurrence, level = level * a + b, which ramps straight with a = 1 and curves
+//exponentially otherwise, so both curves cost the same.  The segment lengths
+//are read as each one starts.  SUSTAIN holds until End(), or for mHold
+//seconds if that is not negative.  Begin and End restart from the current
+//level, so retriggering does not click.
+template<typename T>
+class ADSREnvelope_generic : public olc::sound::synth::Module_generic<T> {
+private:
+	enum class ADSR_STATE {
+		INACTIVE,
+		ATTACK,
+		DECAY,
+		SUSTAIN,
+		RELEASE
+	} mState = ADSR_STATE::INACTIVE;
+
+public:
+	//Events understood by HandleEvent, post these from the game thread.
+	//They take effect at the frame they were posted for
+	enum ADSR_EVENT : uint32_t {
+		BEGIN,
+		END
+	};
+
+	enum class Curve {
+		Linear,
+		Exponential
+	};
+
+	using Property = olc::sound::synth::Property_generic<T>;
+
+	Property mInput = 0.0;
+	Property mAttack = { 0.00f, Property::Rate::Control };
+	Property mDecay = { 0.00f, Property::Rate::Control };
+	Property mSustain = { 1.0f, Property::Rate::Control };
+	//Sample type so they can be set with ModularSynth::PostValue
+	T mRelease = 1.0f;
+	T mHold = -1.0f;
+	//double mRelease = 4.0f;
+	Property mOutput = 0.0f;
+
+	Curve mCurve = Curve::Linear;
+	//Exponential segments aim this fraction of their span past where they
+	//end, smaller is more curved
+	double mOvershoot = 0.01;
+
+public:
+	ADSREnvelope_generic() {
+		this->RegisterInput(&mInput);
+		this->RegisterInput(&mAttack);
+		this->RegisterInput(&mDecay);
+		this->RegisterInput(&mSustain);
+		this->RegisterOutput(&mOutput);
+	}
+
+	//Begin and End must be called on the audio thread
+	void Begin() {
+		Restart(ADSR_STATE::ATTACK);
+	}
+
+	void End() {
+		if (mState != ADSR_STATE::INACTIVE) {
+			Restart(ADSR_STATE::RELEASE);
+		}
+	}
+
+	//Silences the envelope at once, it stays inactive until the next Begin.
+	//A Begin or End already posted for a later frame still happens
+	virtual void Reset() override {
+		mState = ADSR_STATE::INACTIVE;
+		mNext = ADSR_STATE::INACTIVE;
+		Hold(0.0, never);
+	}
+
+	//Begin or End nFrame frames into the block about to be processed
+	void BeginAt(uint32_t nFrame) {
+		mBeginIn = nFrame;
+	}
+
+	void EndAt(uint32_t nFrame) {
+		mEndIn = nFrame;
+	}
+
+	//True once the release has run its course, or if it never began
+	bool Finished() const {
+		return mState == ADSR_STATE::INACTIVE;
+	}
+
+	virtual void HandleEvent(uint32_t nEvent, double dValue) override {
+		HandleEventAt(nEvent, dValue, 0);
+	}
+
+	virtual void HandleEventAt(uint32_t nEvent, double dValue, uint32_t nFrame) override {
+		switch (nEvent) {
+		case BEGIN:
+			BeginAt(nFrame);
+			break;
+		case END:
+			EndAt(nFrame);
+			break;
+		}
+	}
+
+	virtual void Update(uint32_t nChannel, double dTime, double dTimeStep) override {
+		Fire();
+		Advance(dTimeStep);
+		mLevel = mLevel * mA + mB;
+		if (--mLeft == 0) mLevel = mTarget;
+		Count(1);
+
+		mOutput = mLevel * mInput.value;
+	}
+
+	virtual void ProcessBlock(uint32_t nChannel, double dStartTime, double dTimeStep, uint32_t nFrames) override {
+		uint32_t n = 0;
+		while (n < nFrames) {
+			Fire();
+			Advance(dTimeStep);
+
+			//Up to the end of the segment, the block or the next event
+			uint32_t frames = std::min({ mLeft, nFrames - n, mBeginIn, mEndIn });
+			const double a = mA;
+			const double b = mB;
+			double level = mLevel;
+			for (uint32_t i = 0; i < frames; i++) {
+				level = level * a + b;
+				mOutput.Write(n + i, level * mInput[n + i]);
+			}
+			mLevel = level;
+			mLeft -= frames;
+			if (mLeft == 0) mLevel = mTarget;
+			Count(frames);
+			n += frames;
+		}
+	}
+
+private:
+	static constexpr uint32_t never = UINT32_MAX;
+
+	//The segment being played, mLeft frames of level = level * mA + mB ending on mTarget
+	ADSR_STATE mNext = ADSR_STATE::INACTIVE;
+	double mLevel = 0.0;
+	double mTarget = 0.0;
+	double mA = 1.0;
+	double mB = 0.0;
+	uint32_t mLeft = never;
+
+	//Frames until a BeginAt or EndAt takes effect
+	uint32_t mBeginIn = never;
+	uint32_t mEndIn = never;
+
+	//Leave the current segment on the next frame for state
+	void Restart(ADSR_STATE state) {
+		mState = state;
+		mNext = state;
+		mLeft = 0;
+	}
+
+	void Fire() {
+		if (mBeginIn == 0) {
+			mBeginIn = never;
+			Begin();
+		}
+		if (mEndIn == 0) {
+			mEndIn = never;
+			End();
+		}
+	}
+
+	void Count(uint32_t frames) {
+		if (mBeginIn != never) mBeginIn -= frames;
+		if (mEndIn != never) mEndIn -= frames;
+	}
+
+	//Step through segments until one has frames to play, those of no length
+	//just jump to their target
+	void Advance(double dTimeStep) {
+		while (mLeft == 0) {
+			mState = mNext;
+			switch (mState) {
+			case ADSR_STATE::INACTIVE:
+				Hold(0.0, never);
+				break;
+			case ADSR_STATE::ATTACK:
+				mNext = ADSR_STATE::DECAY;
+				Ramp(1.0, mAttack.value, dTimeStep);
+				break;
+			case ADSR_STATE::DECAY:
+				mNext = ADSR_STATE::SUSTAIN;
+				Ramp(mSustain.value, mDecay.value, dTimeStep);
+				break;
+			case ADSR_STATE::SUSTAIN:
+				mNext = mHold < 0 ? ADSR_STATE::SUSTAIN : ADSR_STATE::RELEASE;
+				Hold(mSustain.value, mHold < 0 ? never : Frames(mHold, dTimeStep));
+				break;
+			case ADSR_STATE::RELEASE:
+				mNext = ADSR_STATE::INACTIVE;
+				Ramp(0.0, mRelease, dTimeStep);
+				break;
+				//No default as all cases are taken care of
+			}
+		}
+	}
+
+	static uint32_t Frames(double seconds, double dTimeStep) {
+		return seconds > 0.0 ? static_cast<uint32_t>(std::min(seconds / dTimeStep + 0.5, double(never - 1))) : 0;
+	}
+
+	void Hold(double level, uint32_t frames) {
+		mLevel = level;
+		mTarget = level;
+		mA = 1.0;
+		mB = 0.0;
+		mLeft = frames;
+	}
+
+	//From the current level to target over seconds
+	void Ramp(double target, double seconds, double dTimeStep) {
+		mTarget = target;
+		mLeft = Frames(seconds, dTimeStep);
+		if (mLeft == 0) {
+			mLevel = target;
+		}
+		else if (mCurve == Curve::Linear) {
+			mA = 1.0;
+			mB = (target - mLevel) / mLeft;
+		}
+		else {
+			//Heads for a point past target, placed so target comes after mLeft frames
+			double aim = target + (target - mLevel) * mOvershoot;
+			mA = std::pow(mOvershoot / (1.0 + mOvershoot), 1.0 / mLeft);
+			mB = aim * (1.0 - mA);
+		}
+	}
+};
+
+using ADSREnvelope = ADSREnvelope_generic<olc::sound::synth::Sample>;
+
+//Hands out N pre-constructed voices, only ever from the game thread.
+//Every start bumps the voice's generation, and the voice counts as free again
+//once the audio thread reports that generation released.  With no voice free
+//one is stolen, either the one started longest ago or the quietest.
+//Voice needs Released() and Level(), both readable from the game thread
+template<typename Voice, size_t N>
+class VoiceAllocator {
+public:
+	enum class Steal {
+		Oldest,
+		Quietest
+	};
+
+	Steal steal = Steal::Oldest;
+
+	VoiceAllocator(std::array<Voice, N>& voices_) : voices(voices_) {}
+
+	//Index of the voice to start, pass Generation(index) along with the start
+	size_t Allocate() {
+		size_t chosen = N;
+		for (size_t i = 0; i < N && chosen == N; i++) {
+			if (voices[i].Released() == claimed[i]) {
+				chosen = i;
+			}
+		}
+
+		if (chosen == N) {
+			chosen = 0;
+			for (size_t i = 1; i < N; i++) {
+				bool older = started[i] < started[chosen];
+				if (steal == Steal::Quietest) {
+					float a = voices[i].Level();
+					float b = voices[chosen].Level();
+					if (a < b || (a == b && older)) {
+						chosen = i;
+					}
+				}
+				else if (older) {
+					chosen = i;
+				}
+			}
+		}
+
+		claimed[chosen]++;
+		started[chosen] = ++starts;
+		return chosen;
+	}
+
+	uint32_t Generation(size_t index) const {
+		return claimed[index];
+	}
+
+private:
+	std::array<Voice, N>& voices;
+	std::array<uint32_t, N> claimed = {};
+	std::array<uint64_t, N> started = {};
+	uint64_t starts = 0;
+};
+
+
+//BEGIN THUNDER CODE
+//This is the beginning of some thunder sound code from a paper
+//that was sent to me.  This singular section is about generating
+//the initial "crack" which it kind of does.  It meshed well with what
+//I had already done so I left it in
+
+//This has significant problem with nans leaking into the filter
+//So there is some code elsewhere to clean them out
+//Band pass whose centre sweeps from fc down to fc/2 between d_time and d_prime.
+//Coefficients are only recomputed every control_rate samples and linearly
+//interpolated in between, call Restart after changing fc or the sweep times
+template<typename T>
+class TimeVaryingBPFilter_generic : public olc::sound::synth::Module_generic<T> {
+public:
+	BiquadFilter_generic<T> filter;
+
+	double fc = 500.0;
+	double trigger_time;
+	double d_time = -0.1;
+	double d_prime;
+	double q = 10.0;
+
+	uint32_t control_rate = 16;
+
+	void SetCoefficients(double Fc, double Fs, double Q) {
+		coeff = Coefficients(tan_pi(Fc / Fs), Q);
+		filter.z0 = coeff[0];
+		filter.z1 = 0;
+		filter.z2 = -coeff[0];
+		filter.p1 = coeff[1];
+		filter.p2 = coeff[2];
+	}
+
+	void Restart() {
+		segment_left = 0;
+		restart = true;
+	}
+
+	virtual void Reset() override {
+		filter.Reset();
+	}
+
+	virtual void Update(uint32_t nChannel, double dTime, double dTimeStep) override {
+		if (segment_left == 0) {
+			//Interpolate from where the last segment ended, unless the sweep changed
+			coeff = restart ? SweepCoefficients(dTime) : target;
+			target = SweepCoefficients(dTime + control_rate * dTimeStep);
+			for (size_t i = 0; i < 3; i++) {
+				step[i] = (target[i] - coeff[i]) / control_rate;
+			}
+			segment_left = control_rate;
+			restart = false;
+		}
+
+		filter.z0 = coeff[0];
+		filter.z1 = 0;
+		filter.z2 = -coeff[0];
+		filter.p1 = coeff[1];
+		filter.p2 = coeff[2];
+		filter.Update(nChannel, dTime, dTimeStep);
+
+		for (size_t i = 0; i < 3; i++) {
+			coeff[i] += step[i];
+		}
+		segment_left--;
+	}
+
+	//z0, p1 and p2 of a band pass, z1 is 0 and z2 is -z0
+	static std::array<double, 3> Coefficients(double K, double Q) {
+		double norm = 1 / (1 + (K / Q) + (K * K));
+		return { (K / Q) * norm, 2 * (K * K - 1) * norm, (1 - (K / Q) + (K * K)) * norm };
+	}
+
+private:
+	std::array<double, 3> coeff = {};
+	std::array<double, 3> target = {};
+	std::array<double, 3> step = {};
+	uint32_t segment_left = 0;
+	bool restart = true;
+
+	std::array<double, 3> SweepCoefficients(double dTime) const {
+		double Fc = map(d_time, d_prime, fc, fc / 2.0, dTime);
+		return Coefficients(tan_pi(Fc / samplerate), q);
+	}
+};
+
+using TimeVaryingBPFilter = TimeVaryingBPFilter_generic<olc::sound::synth::Sample>;
+
+template<typename T>
+class StrikeEnvelope_generic : public olc::sound::synth::Module_generic<T> {
+public:
+	using Property = olc::sound::synth::Property_generic<T>;
+
+	double P_strike_intensity = 1.0;
+	double P_strike_distance = 1.0;
+	double max_gain = 2.0;
+	double d;
+	double d_prime;
+
+	double trigger_time;
+	double d_Time;
+
+	Property input;
+	Property output;
+
+	TimeVaryingBPFilter_generic<T> Hbp1;
+	TimeVaryingBPFilter_generic<T> Hbp2;
+
+	StrikeEnvelope_generic() {
+		this->RegisterInput(&input);
+		this->RegisterOutput(&output);
+	}
+
+	//Where the strike's random draws come from, see NoiseGenerator::Seed.
+	//Trigger runs on the audio thread, so it can't use rand() and its lock
+	void Seed(uint32_t nSeed, uint32_t nStream = 0) {
+		rng.Seed(nSeed, nStream);
+	}
+
+	void Trigger() {
+		double r = rng.NextUniform(0.0, 1.0);
+		trigger_time = d_Time;
+		d = d_Time + (rng.NextUniform(0.0, 1.0) * 10) / 343;
+		double temp = std::pow(1.4 - r, 5) * 140;
+		d_prime = d + temp / 1000;
+
+		//Configure filters
+		Hbp1.fc = 100 + rng.NextUniform(0.0, 1.0) * 1200.0;
+		Hbp2.fc = 100 + rng.NextUniform(0.0, 1.0) * 1200.0;
+		Hbp1.d_time = d_Time;
+		Hbp2.d_time = d_Time;
+		Hbp1.d_prime = d_prime;
+		Hbp2.d_prime = d_prime;
+		Hbp1.Restart();
+		Hbp2.Restart();
+
+		//Clear the out state of any nan values
+		Hbp1.filter.o_state = { 0, 0 };
+		Hbp2.filter.o_state = { 0, 0 };
+	}
+
+	virtual void Reset() override {
+		Hbp1.Reset();
+		Hbp2.Reset();
+	}
+
+	virtual void Update(uint32_t nChannel, double dTime, double dTimeStep) override {
+		double gain = 0.0;
+		d_Time = dTime;
+		if (dTime < d) {
+			gain = map(trigger_time, d, 0.0, max_gain, dTime);
+		}
+		else if (dTime < d_prime) {
+			gain = map(d, d_prime, max_gain, 0.0, dTime);
+		}
+		else {
+			gain = 0.0;
+		}
+
+		//The strike is voiced around these two clamps, StrikeBank keeps them too
+		Hbp1.filter.input = std::clamp(input.value * gain, -1.0, 1.0);
+		Hbp2.filter.input = std::clamp(input.value * gain, -1.0, 1.0);
+		Hbp1.Update(nChannel, dTime, dTimeStep);
+		Hbp2.Update(nChannel, dTime, dTimeStep);
+
+		output = std::clamp(100 * (Hbp1.filter.output.value + Hbp2.filter.output.value) / 2.0, -1.0, 1.0);
+	}
+
+private:
+	olc::sound::synth::NoiseGenerator rng;
+};
+
+using StrikeEnvelope = StrikeEnvelope_generic<olc::sound::synth::Sample>;
+
+template<typename T, size_t N>
+class Splitter_generic : public olc::sound::synth::Module_generic<T> {
+public:
+	using Property = olc::sound::synth::Property_generic<T>;
+
+	Property input;
+	std::array<Property, N> output;
+
+	Splitter_generic() {
+		this->RegisterInput(&input);
+		for (size_t i = 0; i < N; i++) {
+			this->RegisterOutput(&output[i]);
+		}
+	}
+
+	virtual void Update(uint32_t nChannel, double dTime, double dTimeStep) override {
+		for (size_t i = 0; i < N; i++) {
+			output[i] = input.value;
+		}
+	}
+
+	virtual void ProcessBlock(uint32_t nChannel, double dStartTime, double dTimeStep, uint32_t nFrames) override {
+		for (uint32_t n = 0; n < nFrames; n++) {
+			T in = input[n];
+			for (size_t i = 0; i < N; i++) {
+				output[i].Write(n, in);
+			}
+		}
+	}
+
+};
+
+template<size_t N>
+using Splitter = Splitter_generic<olc::sound::synth::Sample, N>;
+
+//All 6x4 StrikeEnvelopes of a LightningStrike, stored as a structure of arrays.
+//Each voice owns one lane of the arrays below and Process steps through them
+//simd::width voices at a time.  The arithmetic follows StrikeEnvelope and
+//TimeVaryingBPFilter operation for operation so the output matches the scalar
+//modules, including the control rate coefficient updates.
+//It always runs in double, the sweeps compare absolute times and the band
+//passes at a few hundred Hz need the precision.
+class StrikeBank {
+public:
+	static constexpr size_t branches = 6;
+	static constexpr size_t voices_per_branch = 4;
+	static constexpr size_t voices = branches * voices_per_branch;
+
+	double max_gain = 2.0;
+	double q = 10.0;
+	uint32_t control_rate = 16;
+
+	//See StrikeEnvelope::Seed
+	void Seed(uint32_t nSeed, uint32_t nStream = 0) {
+		rng.Seed(nSeed, nStream);
+	}
+
+	//Same random draws, in the same order, as calling StrikeEnvelope::Trigger
+	//on each envelope branch by branch with one shared generator.  dTime is
+	//the synth time of the strike, the bank's own clock stops while it isn't
+	//processed so it can't be trusted here
+	void Trigger(double dTime) {
+		d_Time = dTime;
+		for (size_t v = 0; v < voices; v++) {
+			double r = rng.NextUniform(0.0, 1.0);
+			trigger_time[v] = d_Time;
+			d[v] = d_Time + (rng.NextUniform(0.0, 1.0) * 10) / 343;
+			double temp = std::pow(1.4 - r, 5) * 140;
+			d_prime[v] = d[v] + temp / 1000;
+
+			f1.fc[v] = 100 + rng.NextUniform(0.0, 1.0) * 1200.0;
+			f2.fc[v] = 100 + rng.NextUniform(0.0, 1.0) * 1200.0;
+
+			//Clear the out state of any nan values
+			f1.o1[v] = 0.0;
+			f1.o2[v] = 0.0;
+			f2.o1[v] = 0.0;
+			f2.o2[v] = 0.0;
+		}
+		segment_left = 0;
+		restart = true;
+	}
+
+	//Silence every band pass, as StrikeEnvelope::Reset
+	void Reset() {
+		for (BandPassLanes* f : { &f1, &f2 }) {
+			f->i1 = {};
+			f->i2 = {};
+			f->o1 = {};
+			f->o2 = {};
+		}
+	}
+
+	//Run one frame.  in holds one sample per branch, out receives the
+	//branch mixes (the 4 voices of a branch summed and divided by 4)
+	void Process(double dTime, double dTimeStep, const std::array<double, branches>& in, std::array<double, branches>& out) {
+		using namespace simd;
+		d_Time = dTime;
+
+		if (segment_left == 0) {
+			StartSegment(dTime, dTimeStep);
+		}
+
+		for (size_t v = 0; v < voices; v++) {
+			x[v] = in[v / voices_per_branch];
+		}
+
+		const Lane t = Set(dTime);
+		const Lane zero = Set(0.0);
+		const Lane one = Set(1.0);
+		const Lane two = Set(2.0);
+		const Lane gmax = Set(max_gain);
+		const Lane hundred = Set(100.0);
+
+		for (size_t v = 0; v < voices; v += width) {
+			Lane peak = Load(&d[v]);
+			Lane end = Load(&d_prime[v]);
+
+			//Envelope gain, both ramps are evaluated and the right one selected
+			Lane rise = Ramp(Load(&trigger_time[v]), peak, zero, gmax, t);
+			Lane fall = Ramp(peak, end, gmax, zero, t);
+			Lane gain = Select(Less(t, peak), rise, Select(Less(t, end), fall, zero));
+			Lane in_v = Clamp(Mul(Load(&x[v]), gain), Sub(zero, one), one);
+
+			Lane o1 = f1.Process(v, in_v);
+			Lane o2 = f2.Process(v, in_v);
+			Store(&y[v], Clamp(Div(Mul(hundred, Add(o1, o2)), two), Sub(zero, one), one));
+		}
+		segment_left--;
+
+		for (size_t b = 0; b < branches; b++) {
+			double mix = 0.0;
+			for (size_t j = 0; j < voices_per_branch; j++) {
+				mix += y[b * voices_per_branch + j];
+			}
+			out[b] = std::clamp(mix / voices_per_branch, -1.0, 1.0);
+		}
+	}
+
+private:
+	using Lanes = std::array<double, voices>;
+
+	static_assert(voices % simd::width == 0, "voices must fill whole simd lanes");
+
+	//One band pass per voice, z1 is 0 and z2 is -z0
+	struct BandPassLanes {
+		alignas(32) Lanes fc = {};
+		alignas(32) Lanes i1 = {};
+		alignas(32) Lanes i2 = {};
+		alignas(32) Lanes o1 = {};
+		alignas(32) Lanes o2 = {};
+
+		//Current coefficients, their value at the end of the segment and the per sample step
+		alignas(32) Lanes z0 = {};
+		alignas(32) Lanes p1 = {};
+		alignas(32) Lanes p2 = {};
+		alignas(32) Lanes z0_end = {};
+		alignas(32) Lanes p1_end = {};
+		alignas(32) Lanes p2_end = {};
+		alignas(32) Lanes z0_step = {};
+		alignas(32) Lanes p1_step = {};
+		alignas(32) Lanes p2_step = {};
+
+		//BiquadFilter::Update on lanes v .. v + width, then step the coefficients
+		simd::Lane Process(size_t v, simd::Lane in) {
+			using namespace simd;
+			Lane b0 = Load(&z0[v]);
+			Lane a1 = Load(&p1[v]);
+			Lane a2 = Load(&p2[v]);
+			Lane y1 = Load(&o1[v]);
+			Lane out = Sub(Sub(Sub(Mul(in, b0), Mul(Load(&i2[v]), b0)), Mul(y1, a1)), Mul(Load(&o2[v]), a2));
+			Store(&o2[v], y1);
+			Store(&i2[v], Load(&i1[v]));
+			Store(&o1[v], out);
+			Store(&i1[v], in);
+
+			Store(&z0[v], Add(b0, Load(&z0_step[v])));
+			Store(&p1[v], Add(a1, Load(&p1_step[v])));
+			Store(&p2[v], Add(a2, Load(&p2_step[v])));
+			return out;
+		}
+	};
+
+	double d_Time = 0.0;
+	uint32_t segment_left = 0;
+	bool restart = true;
+	olc::sound::synth::NoiseGenerator rng;
+
+	//Envelope state
+	alignas(32) Lanes trigger_time = {};
+	alignas(32) Lanes d = {};
+	alignas(32) Lanes d_prime = {};
+
+	BandPassLanes f1;
+	BandPassLanes f2;
+
+	//Per frame scratch
+	alignas(32) Lanes x = {};
+	alignas(32) Lanes y = {};
+
+	//Same as TimeVaryingBPFilter::Update at the start of a segment
+	void StartSegment(double dTime, double dTimeStep) {
+		using namespace simd;
+		const Lane t = Set(dTime);
+		const Lane t_end = Set(dTime + control_rate * dTimeStep);
+		const Lane n = Set(static_cast<double>(control_rate));
+
+		for (size_t v = 0; v < voices; v += width) {
+			Lane start = Load(&trigger_time[v]);
+			Lane end = Load(&d_prime[v]);
+			for (BandPassLanes* f : { &f1, &f2 }) {
+				Lane z0, p1, p2;
+				if (restart) {
+					Coefficients(start, end, Load(&f->fc[v]), t, z0, p1, p2);
+				}
+				else {
+					z0 = Load(&f->z0_end[v]);
+					p1 = Load(&f->p1_end[v]);
+					p2 = Load(&f->p2_end[v]);
+				}
+				Lane z0_end, p1_end, p2_end;
+				Coefficients(start, end, Load(&f->fc[v]), t_end, z0_end, p1_end, p2_end);
+
+				Store(&f->z0[v], z0);
+				Store(&f->p1[v], p1);
+				Store(&f->p2[v], p2);
+				Store(&f->z0_end[v], z0_end);
+				Store(&f->p1_end[v], p1_end);
+				Store(&f->p2_end[v], p2_end);
+				Store(&f->z0_step[v], Div(Sub(z0_end, z0), n));
+				Store(&f->p1_step[v], Div(Sub(p1_end, p1), n));
+				Store(&f->p2_step[v], Div(Sub(p2_end, p2), n));
+			}
+		}
+		segment_left = control_rate;
+		restart = false;
+	}
+
+	//Band pass coefficients of the sweep from fc to fc/2 at time t
+	void Coefficients(simd::Lane start, simd::Lane end, simd::Lane fc, simd::Lane t, simd::Lane& z0, simd::Lane& p1, simd::Lane& p2) const {
+		using namespace simd;
+		const Lane one = Set(1.0);
+		const Lane Q = Set(q);
+		Lane Fc = Ramp(start, end, fc, Div(fc, Set(2.0)), t);
+		Lane K = TanPi(Div(Fc, Set(samplerate)));
+		Lane KK = Mul(K, K);
+		Lane norm = Div(one, Add(Add(one, Div(K, Q)), KK));
+		z0 = Mul(Div(K, Q), norm);
+		p1 = Mul(Mul(Set(2.0), Sub(KK, one)), norm);
+		p2 = Mul(Add(Sub(one, Div(K, Q)), KK), norm);
+	}
+
+	//map() per lane, including the narrowing of t to float that lerp does
+	static simd::Lane Ramp(simd::Lane in_start, simd::Lane in_end, simd::Lane out_start, simd::Lane out_end, simd::Lane val) {
+		using namespace simd;
+		Lane t = Clamp(Div(Sub(val, in_start), Sub(in_end, in_start)), Set(0.0), Set(1.0));
+		return Add(Mul(out_start, NarrowComplement(t)), Mul(out_end, Narrow(t)));
+	}
+
+	//tan_pi per lane
+	static simd::Lane TanPi(simd::Lane x) {
+		using namespace simd;
+		Mask reflect = Less(Set(0.25), x);
+		Lane r = Mul(Set(3.14159265359), Select(reflect, Sub(Set(0.5), x), x));
+		Lane r2 = Mul(r, r);
+		Lane num = Mul(r, Add(Set(945.0), Mul(r2, Add(Set(-105.0), r2))));
+		Lane den = Add(Set(945.0), Mul(r2, Add(Set(-420.0), Mul(Set(15.0), r2))));
+		Lane t = Div(num, den);
+		return Select(reflect, Div(Set(1.0), t), t);
+	}
+};
+
+template<typename T>
+class LightningStrike_generic : public olc::sound::synth::Module_generic<T> {
+public:
+	using Property = olc::sound::synth::Property_generic<T>;
+	using Oscillator = olc::sound::synth::modules::Oscillator_generic<T>;
+
+	//Only the 6 source oscillators live in the synth, the envelopes and
+	//filters they feed are all in the bank
+	olc::sound::synth::ModularSynth_generic<T> mSynth;
+	std::array<Oscillator, 6> X;
+
+	StrikeBank bank;
+	std::array<double, 6> amplitude = {};
+
+	Property output = 0.0;
+
+	double max_mag = 0;
+
+	//Events understood by HandleEvent, post these from the game thread
+	enum STRIKE_EVENT : uint32_t {
+		TRIGGER,
+		SET_LCOUNT
+	};
+
+	LightningStrike_generic() {
+		for (int i = 0; i < 6; i++) {
+			if (i % 2 == 0) {
+				X[i].waveform = Oscillator::Type::PWM;
+				X[i].frequency = 1000 / 20000;
+				X[i].parameter = 0.9;
+			}
+			else {
+				X[i].waveform = Oscillator::Type::Noise;
+			}
+			mSynth.AddModule(&X[i]);
+			mSynth.AddOutput(&X[i].output);
+		}
+		mSynth.Compile();
+		Seed(0xB00B1E5, 0);
+
+		this->RegisterOutput(&output);
+	}
+
+	//Source i takes noise stream nStream * 6 + i, so the branches and any
+	//strikes given different nStream never share their noise.  The strike's
+	//own random draws take stream nStream from the top half of the streams
+	void Seed(uint32_t nSeed, uint32_t nStream) {
+		for (uint32_t i = 0; i < 6; i++) {
+			X[i].Seed(nSeed, nStream * 6 + i);
+		}
+		bank.Seed(nSeed, 0x80000000u | nStream);
+	}
+
+	//Strikes nFrame frames into the next block processed.  The bank only
+	//learns the time when it is processed, which a sleeping voice doesn't do
+	void Trigger(uint32_t nFrame = 0) {
+		trigger_in = nFrame;
+	}
+
+	//Strikes at synth time dTime
+	void TriggerAt(double dTime) {
+		trigger_in = never;
+		bank.Trigger(dTime);
+	}
+
+	virtual void Reset() override {
+		bank.Reset();
+	}
+
+	void SetLCount(int count) {
+		int c = std::max(1, std::min(6, count));
+
+		for (int i = 0; i < c; i++) {
+			amplitude[i] = 1.0;
+		}
+
+		for (int i = c; i < 6; i++) {
+			amplitude[i] = 0.0;
+		}
+	}
+
+	virtual void HandleEvent(uint32_t nEvent, double dValue) override {
+		HandleEventAt(nEvent, dValue, 0);
+	}
+
+	virtual void HandleEventAt(uint32_t nEvent, double dValue, uint32_t nFrame) override {
+		switch (nEvent) {
+		case TRIGGER:
+			Trigger(nFrame);
+			break;
+		case SET_LCOUNT:
+			SetLCount(static_cast<int>(dValue));
+			break;
+		}
+	}
+
+	virtual void Update(uint32_t nChannel, double dTime, double dTimeStep) override {
+		if (trigger_in == 0) {
+			TriggerAt(dTime);
+		}
+		else if (trigger_in != never) {
+			trigger_in--;
+		}
+		mSynth.Update(nChannel, dTime, dTimeStep);
+		output = Mix(dTime, dTimeStep, [&](size_t i) { return X[i].output.value; });
+	}
+
+	virtual void ProcessBlock(uint32_t nChannel, double dStartTime, double dTimeStep, uint32_t nFrames) override {
+		mSynth.ProcessBlock(nChannel, dStartTime, dTimeStep, nFrames);
+		for (uint32_t n = 0; n < nFrames; n++) {
+			double t = dStartTime + n * dTimeStep;
+			if (n == trigger_in) {
+				TriggerAt(t);
+			}
+			output.Write(n, Mix(t, dTimeStep, [&](size_t i) { return X[i].output[n]; }));
+		}
+		if (trigger_in != never) {
+			trigger_in -= nFrames;
+		}
+	}
+
+private:
+	static constexpr uint32_t never = UINT32_MAX;
+
+	//Frames until a Trigger takes effect
+	uint32_t trigger_in = never;
+	std::array<double, 6> branch_in = {};
+	std::array<double, 6> branch_out = {};
+
+	//One frame through the bank and the branch mixer
+	template<typename Source>
+	double Mix(double dTime, double dTimeStep, Source source) {
+		for (size_t i = 0; i < 6; i++) {
+			branch_in[i] = std::clamp<double>(source(i), -1.0, 1.0);
+		}
+		bank.Process(dTime, dTimeStep, branch_in, branch_out);
+
+		double out = 0.0;
+		for (size_t i = 0; i < 6; i++) {
+			out += amplitude[i] * branch_out[i];
+		}
+		out = std::clamp(out / 6, -1.0, 1.0);
+		max_mag = std::max(max_mag, std::abs(out));
+		return out;
+	}
+};
+
+using LightningStrike = LightningStrike_generic<olc::sound::synth::Sample>;
+
+//END THUNDER CODE
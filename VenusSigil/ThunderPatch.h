@@ -0,0 +1,354 @@
+#pragma once
+#include "SynthModules.h"
+
+//The sound of one bolt: an echo of the background noise, the strike itself
+//and the envelopes that shape them.  The noise and rumble come in from the
+//patch.  While idle the voice only keeps its echo running and outputs
+//silence, it goes idle by itself once its envelope has faded out.
+template<typename T>
+class ThunderVoice_generic : public olc::sound::synth::Module_generic<T> {
+public:
+	//Events understood by HandleEvent, dValue is the generation from VoiceAllocator
+	enum VOICE_EVENT : uint32_t {
+		STRIKE
+	};
+
+	ThunderVoice_generic() {
+		//A strike is over in an instant, the envelopes release straight away
+		adsr.mHold = 0.0;
+		adsr2.mHold = 0.0;
+		adsr2.mRelease = 2.5;
+		mixer.amplitude[0] = .20;
+		mixer.amplitude[1] = .20;
+		mixer.amplitude[2] = 1.0;
+		mixer.amplitude[3] = .20;
+
+		delay.decay = .55;
+		delay.glide = .02;
+
+		mSynth.AddModule(&noise_in);
+		mSynth.AddModule(&rumble_in);
+		mSynth.AddModule(&adsr);
+		mSynth.AddModule(&adsr2);
+		mSynth.AddModule(&delay);
+		mSynth.AddModule(&mixer);
+		mSynth.AddModule(&gain);
+		mSynth.AddModule(&clip);
+		mSynth.AddModule(&ls);
+
+		mSynth.AddPatch(&noise_in.output[0], &mixer.inputs[0]);
+		mSynth.AddPatch(&noise_in.output[1], &delay.input);
+		mSynth.AddPatch(&delay.output, &mixer.inputs[1]);
+		mSynth.AddPatch(&rumble_in.output[0], &mixer.inputs[2]);
+		mSynth.AddPatch(&ls.output, &mixer.inputs[3]);
+		mSynth.AddPatch(&mixer.output, &gain.input);
+		mSynth.AddPatch(&gain.output, &adsr.mInput);
+		//Up to 6x gain driven into a hard clip is part of the strike's sound
+		mSynth.AddPatch(&adsr.mOutput, &clip.input);
+		mSynth.AddPatch(&clip.output, &adsr2.mInput);
+		mSynth.AddOutput(&adsr2.mOutput);
+		mSynth.Compile();
+
+		ls.SetLCount(6);
+
+		//The splitter inputs are patched from the outer synth, so they are
+		//this module's inputs rather than part of the inner graph
+		this->RegisterInput(&noise_in.input);
+		this->RegisterInput(&rumble_in.input);
+		this->RegisterOutput(&output);
+	}
+
+	//Called on the audio thread, any parameters posted before the strike
+	//have already been applied.  The envelopes open and the strike cracks
+	//nFrame frames into the next block
+	void Strike(uint32_t nGeneration, uint32_t nFrame = 0) {
+		generation = nGeneration;
+		adsr.BeginAt(nFrame);
+		adsr2.BeginAt(nFrame);
+		ls.Trigger(nFrame);
+		active = true;
+	}
+
+	//Clears the echo and the strike's filters and stops the envelopes, so a
+	//voice reset by its guard ends the strike and frees itself
+	virtual void Reset() override {
+		delay.Reset();
+		ls.Reset();
+		adsr.Reset();
+		adsr2.Reset();
+	}
+
+	//Last generation the audio thread finished with, for VoiceAllocator
+	uint32_t Released() const {
+		return released.load(std::memory_order_acquire);
+	}
+
+	//Peak output of the last block, for VoiceAllocator
+	float Level() const {
+		return level.load(std::memory_order_relaxed);
+	}
+
+	virtual void HandleEvent(uint32_t nEvent, double dValue) override {
+		HandleEventAt(nEvent, dValue, 0);
+	}
+
+	virtual void HandleEventAt(uint32_t nEvent, double dValue, uint32_t nFrame) override {
+		switch (nEvent) {
+		case STRIKE:
+			Strike(static_cast<uint32_t>(dValue), nFrame);
+			break;
+		}
+	}
+
+	virtual void Update(uint32_t nChannel, double dTime, double dTimeStep) override {
+		if (!active) {
+			output = 0.0;
+			return;
+		}
+		mSynth.Update(nChannel, dTime, dTimeStep);
+		output = adsr2.mOutput.value;
+		Finish(std::abs(output.value));
+	}
+
+	virtual void ProcessBlock(uint32_t nChannel, double dStartTime, double dTimeStep, uint32_t nFrames) override {
+		if (!active) {
+			//Keep the echo fed so it never starts out silent, it is cheap next to the strike
+			noise_in.ProcessBlock(nChannel, dStartTime, dTimeStep, nFrames);
+			delay.ProcessBlock(nChannel, dStartTime, dTimeStep, nFrames);
+			for (uint32_t n = 0; n < nFrames; n++) {
+				output.Write(n, 0.0);
+			}
+			return;
+		}
+
+		mSynth.ProcessBlock(nChannel, dStartTime, dTimeStep, nFrames);
+		double peak = 0.0;
+		for (uint32_t n = 0; n < nFrames; n++) {
+			T f = adsr2.mOutput[n];
+			peak = std::max<double>(peak, std::abs(f));
+			output.Write(n, f);
+		}
+		Finish(peak);
+	}
+
+	Splitter_generic<T, 2> noise_in;
+	Splitter_generic<T, 1> rumble_in;
+	olc::sound::synth::Property_generic<T> output;
+
+	ADSREnvelope_generic<T> adsr;
+	ADSREnvelope_generic<T> adsr2;
+	Mixer_generic<T, 5> mixer;
+	Gain_generic<T> gain;
+	Saturator_generic<T> clip;
+	LightningStrike_generic<T> ls;
+	DelayLine_generic<T> delay{ 2.0 };
+
+private:
+	olc::sound::synth::ModularSynth_generic<T> mSynth;
+	uint32_t generation = 0;
+	bool active = false;
+	std::atomic<uint32_t> released{ 0 };
+	std::atomic<float> level{ 0.0f };
+
+	//Publish the level and hand the voice back once it has faded out
+	void Finish(double peak) {
+		if (adsr2.Finished()) {
+			active = false;
+			level.store(0.0f, std::memory_order_relaxed);
+			released.store(generation, std::memory_order_release);
+		}
+		else {
+			level.store(static_cast<float>(peak), std::memory_order_relaxed);
+		}
+	}
+};
+
+using ThunderVoice = ThunderVoice_generic<olc::sound::synth::Sample>;
+
+//The sound of the game. Pink noise rumbles away in the background and
+//each bolt takes a voice from the pool to add a strike, an echo and a
+//release on top of it.  When every voice is busy the oldest is restarted.
+//The voices make this large, so keep it on the heap.
+template<typename T>
+class ThunderPatch_generic {
+public:
+	using Oscillator = olc::sound::synth::modules::Oscillator_generic<T>;
+	using Voice = ThunderVoice_generic<T>;
+
+	ThunderPatch_generic() : allocator(voices) {
+		osc1.waveform = Oscillator::Type::Noise;
+
+		osc1.frequency = .25;
+		osc1.amplitude = 1.0;
+		osc1.parameter = 0.5;
+
+		rumbles.Configure(0, samplerate, 23, 20, 1, BiquadFilter_generic<T>::Type::LowPass);
+		rumbles.Configure(1, samplerate, 47, 20, 1, BiquadFilter_generic<T>::Type::LowPass);
+		rumbles.Configure(2, samplerate, 61, 20, 1, BiquadFilter_generic<T>::Type::LowPass);
+		rumbles.Configure(3, samplerate, 97, 20, 1, BiquadFilter_generic<T>::Type::LowPass);
+		rumbles.Configure(4, samplerate, 113, 20, 1, BiquadFilter_generic<T>::Type::LowPass);
+
+		rumbles_osc[0].frequency = 0.11 / 20000;
+		rumbles_osc[1].frequency = 0.07 / 20000;
+		rumbles_osc[2].frequency = 0.05 / 20000;
+		rumbles_osc[3].frequency = 0.03 / 20000;
+		rumbles_osc[4].frequency = 0.02 / 20000;
+
+		synth.AddModule(&rumbles);
+		for (int i = 0; i < 5; i++) {
+			synth.AddModule(&rumbles_osc[i]);
+			synth.AddPatch(&rumbles_osc[i].output, &rumble_mixer.amplitude[i]);
+			synth.AddPatch(&rumbles.output[i], &rumble_mixer.inputs[i]);
+		}
+
+		synth.AddModule(&rumble_mixer);
+
+		final_output.amplitude[0] = 1.0;
+		final_output.amplitude[1] = 1.0;
+
+		synth.AddModule(&osc1);
+		synth.AddModule(&pink_filter);
+		for (auto& voice : voices) {
+			synth.AddModule(&voice);
+		}
+		for (auto& voice_guard : voice_guards) {
+			synth.AddModule(&voice_guard);
+		}
+		synth.AddModule(&bed_guard);
+		synth.AddModule(&voice_mix);
+		synth.AddModule(&final_output);
+		synth.AddModule(&guard);
+		synth.AddModule(&master);
+
+		//osc1 keeps stream 0, every voice gets its own strike noise
+		for (uint32_t i = 0; i < voice_count; i++) {
+			voices[i].ls.Seed(0xB00B1E5, i + 1);
+		}
+
+		synth.AddPatch(&osc1.output, &pink_filter.input);
+		synth.AddPatch(&pink_filter.output, &rumbles.input);
+
+		for (size_t i = 0; i < voice_count; i++) {
+			synth.AddPatch(&pink_filter.output, &voices[i].noise_in.input);
+			synth.AddPatch(&rumble_mixer.output, &voices[i].rumble_in.input);
+			synth.AddPatch(&voices[i].output, &voice_guards[i].input);
+			synth.AddPatch(&voice_guards[i].output, &voice_mix.inputs[i]);
+		}
+		synth.AddPatch(&voice_mix.output, &final_output.inputs[0]);
+		synth.AddPatch(&rumble_mixer.output, &bed_guard.input);
+		synth.AddPatch(&bed_guard.output, &final_output.inputs[1]);
+		synth.AddPatch(&final_output.output, &guard.input);
+		synth.AddPatch(&guard.output, &master.input);
+
+		//Each voice and the background are guarded apart, so a nan in one
+		//strike mutes and resets that voice while the rumble carries on.
+		//The bed's guard holds everything with state a nan could get stuck
+		//in that isn't a voice
+		for (size_t i = 0; i < voice_count; i++) {
+			voice_guards[i].Watch(&voices[i]);
+		}
+		bed_guard.Watch(&pink_filter);
+		bed_guard.Watch(&rumbles);
+		synth.AddOutput(&master.output);
+
+		//The slow sines only need to run once a block
+		for (auto& osc : rumbles_osc) {
+			synth.SetControlRate(&osc, block_size);
+		}
+		synth.Compile(block_size);
+	}
+
+	//Set up the sound of the next bolt, r is the random value the bolt was
+	//built from and release is how long the sound fades out over.
+	//Call from the game thread, it takes effect on the next Strike
+	void Prepare(float r, double release) {
+		next_r = r;
+		next_release = release;
+	}
+
+	//Start the sound of the bolt on a free voice, call from the game thread.
+	//dTime is the synth time to strike at, to the sample for the envelopes
+	//and the crack alike, 0 strikes on the next block.  The parameters are
+	//posted ahead of the strike so they land first.  Returns false, with no
+	//voice taken, if the event queue can't hold them all
+	bool Strike(double dTime = 0.0) {
+		//Only claim a voice once every post is sure to go in, a dropped STRIKE
+		//would leave the voice busy until it was stolen
+		if (synth.EventSpace() < strike_posts) {
+			return false;
+		}
+
+		size_t v = allocator.Allocate();
+		Voice& voice = voices[v];
+		synth.PostValue(&voice.delay.delay, 0.1 + next_r * (0.9), dTime);
+		synth.PostValue(&voice.gain.gain, 1, dTime);
+		synth.PostEvent(&voice.ls, LightningStrike_generic<T>::SET_LCOUNT, 1 + floor(next_r * 6), dTime);
+		synth.PostValue(&voice.adsr.mRelease, next_release, dTime);
+		synth.PostValue(&voice.adsr2.mRelease, next_release, dTime);
+		synth.PostEvent(&voice, Voice::STRIKE, allocator.Generation(v), dTime);
+		return true;
+	}
+
+	//Blocks muted for nan or infinity by any of the guards, safe to read
+	//from any thread
+	uint32_t NanEvents() const {
+		uint32_t total = bed_guard.Events() + guard.Events();
+		for (auto& voice_guard : voice_guards) {
+			total += voice_guard.Events();
+		}
+		return total;
+	}
+
+	//Called once per block on the audio thread, see WaveEngine::SetCallBack_SynthBlock
+	//The patch is mono, so every channel of a frame gets the same sample
+	void GetBlock(float* buffer, uint32_t channels, uint32_t frames, double dTime, double dTimeStep) {
+		uint32_t done = 0;
+		while (done < frames) {
+			if (frame >= block_size) {
+				synth.ProcessBlock(0, dTime + done * dTimeStep, dTimeStep, block_size);
+				frame = 0;
+			}
+			uint32_t count = std::min(block_size - frame, frames - done);
+			for (uint32_t n = 0; n < count; n++) {
+				float sample = master.output[frame + n];
+				for (uint32_t c = 0; c < channels; c++) {
+					buffer[(done + n) * channels + c] = sample;
+				}
+			}
+			frame += count;
+			done += count;
+		}
+	}
+
+	olc::sound::synth::ModularSynth_generic<T> synth;
+	uint32_t block_size = 64;
+	uint32_t frame = 64;
+	Oscillator osc1;
+	Pinkifier_generic<T> pink_filter;
+	BiquadBank_generic<T, 5> rumbles;
+	Mixer_generic<T, 5> rumble_mixer;
+	Mixer_generic<T, 2> final_output;
+	//Last resort should anything unguarded go bad, see NanEvents()
+	NanGuard_generic<T> guard;
+	//Nothing upstream clamps, this keeps the output in range
+	Saturator_generic<T> master;
+	std::array<Oscillator, 5> rumbles_osc;
+
+	static constexpr size_t voice_count = 4;
+	std::array<Voice, voice_count> voices;
+	VoiceAllocator<Voice, voice_count> allocator;
+	Sum_generic<T, voice_count> voice_mix;
+
+	//Silence and recover from nan or infinity, one voice or the bed at a time
+	std::array<NanGuard_generic<T>, voice_count> voice_guards;
+	NanGuard_generic<T> bed_guard;
+
+	//Events Strike posts
+	static constexpr size_t strike_posts = 6;
+
+	//Game thread only, see Prepare
+	float next_r = 0.5f;
+	double next_release = 1.0;
+};
+
+using ThunderPatch = ThunderPatch_generic<olc::sound::synth::Sample>;
@@ -0,0 +1,322 @@
+//DSP benchmark for the synth modules
+//
+//Runs each module, and then the whole ThunderPatch, over the same seeded
+//input for a fixed length of audio, several times over. Prints one CSV line
+//per module with the cost per sample, the spread between runs and the
+//real-time factor, so results can be compared between builds.  Then times
+//loading that length of audio from a .wav file in each sample size.
+//
+//Build with bench_build.sh, then run
+//	venus_sigil_bench [seconds] [runs] [block_size] [seed] [threads]
+//threads only applies to the ThunderPatch runs, see ModularSynth::SetThreads.
+//The modules run with the build's sample type, ThunderPatch with both
+#define OLC_SOUNDWAVE
+#define SOUNDWAVE_USING_OFFLINE
+#include "olcSoundWaveEngine.h"
+
+#include "ThunderPatch.h"
+
+#include <chrono>
+#include <cstdio>
+#include <functional>
+
+//Plays back a fixed buffer of samples, so every module sees the same input
+class BufferSource : public olc::sound::synth::Module {
+public:
+	std::vector<double> samples;
+	size_t position = 0;
+	olc::sound::synth::Property output;
+
+	BufferSource() {
+		RegisterOutput(&output);
+	}
+
+	virtual void Update(uint32_t nChannel, double dTime, double dTimeStep) override {
+		output.value = samples[position];
+		position = (position + 1) % samples.size();
+	}
+
+	virtual void ProcessBlock(uint32_t nChannel, double dStartTime, double dTimeStep, uint32_t nFrames) override {
+		for (uint32_t n = 0; n < nFrames; n++) {
+			output.Write(n, samples[position]);
+			position = (position + 1) % samples.size();
+		}
+	}
+};
+
+struct BenchSettings {
+	double seconds = 10.0;
+	int runs = 5;
+	uint32_t block_size = 64;
+	unsigned int seed = 1;
+	uint32_t threads = 1;
+	std::vector<double> input;
+};
+
+//Each benchmark builds a fresh graph and returns a function that renders one block
+using BlockFunction = std::function<void(uint32_t nFrames, double dTime)>;
+using BenchSetup = std::function<BlockFunction()>;
+
+//Prints the CSV line for one benchmark
+void Report(const char* name, const BenchSettings& settings, const std::vector<double>& ns_per_sample) {
+	double mean = std::accumulate(ns_per_sample.begin(), ns_per_sample.end(), 0.0) / ns_per_sample.size();
+	double variance = 0.0;
+	for (double ns : ns_per_sample) {
+		variance += (ns - mean) * (ns - mean);
+	}
+	variance /= ns_per_sample.size();
+
+	//One sample of audio lasts 1e9 / samplerate nanoseconds
+	double realtime_factor = (1e9 / samplerate) / mean;
+
+	printf("%s,%u,%d,%.3f,%.3f,%.1f\n", name, settings.block_size, settings.runs, mean, std::sqrt(variance), realtime_factor);
+	fflush(stdout);
+}
+
+void Run(const char* name, const BenchSettings& settings, const BenchSetup& setup) {
+	const uint32_t total_frames = static_cast<uint32_t>(settings.seconds * samplerate);
+	std::vector<double> ns_per_sample;
+
+	for (int run = 0; run < settings.runs; run++) {
+		srand(settings.seed);
+		BlockFunction block = setup();
+
+		auto start = std::chrono::steady_clock::now();
+		for (uint32_t done = 0; done < total_frames; done += settings.block_size) {
+			uint32_t frames = std::min(settings.block_size, total_frames - done);
+			block(frames, static_cast<double>(done) / samplerate);
+		}
+		std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+		ns_per_sample.push_back(elapsed.count() / total_frames);
+	}
+
+	Report(name, settings, ns_per_sample);
+}
+
+//Benchmark 16 voices looping the shared input through a WaveEngine, as if it
+//had been recorded at 48kHz.  With resample the wave is converted to the
+//engine's rate first, so at speed 1 the voices are straight copies
+void RunWaves(const char* name, const BenchSettings& settings, olc::sound::wave::Quality quality, double speed, bool resample) {
+	auto wave = std::make_shared<olc::sound::Wave>(1, 4, 48000, settings.input.size());
+	std::copy(settings.input.begin(), settings.input.end(), wave->file.data());
+	if (resample) wave->Resample(samplerate, quality);
+
+	Run(name, settings, [&]() -> BlockFunction {
+		auto engine = std::make_shared<olc::sound::WaveEngine>();
+		auto buffer = std::make_shared<std::vector<float>>();
+		engine->InitialiseOffline(samplerate, 1, settings.block_size);
+		engine->SetResampleQuality(quality);
+		for (int i = 0; i < 16; i++) {
+			engine->PlayWaveform(wave.get(), true, speed);
+		}
+		return [wave, engine, buffer](uint32_t nFrames, double dTime) {
+			engine->RenderOffline(*buffer, nFrames);
+		};
+	});
+}
+
+//Benchmark loading a stereo .wav of the same length with sample_size bytes
+//per sample, 1 to 4.  The cost is per frame of the file
+void RunLoad(const char* name, const BenchSettings& settings, size_t sample_size) {
+	const size_t total_frames = static_cast<size_t>(settings.seconds * samplerate);
+	const std::string filename = "venus_sigil_bench_load.wav";
+	{
+		olc::sound::wave::File<float> file(2, sample_size, samplerate, total_frames);
+		for (size_t i = 0; i < total_frames * 2; i++) {
+			file.data()[i] = static_cast<float>(settings.input[(i / 2) % settings.input.size()]);
+		}
+		if (!file.SaveFile(filename)) {
+			printf("%s,could not write %s\n", name, filename.c_str());
+			return;
+		}
+	}
+
+	std::vector<double> ns_per_sample;
+	for (int run = 0; run < settings.runs; run++) {
+		olc::sound::wave::File<float> file;
+		auto start = std::chrono::steady_clock::now();
+		file.LoadFile(filename);
+		std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+		ns_per_sample.push_back(elapsed.count() / total_frames);
+	}
+	std::remove(filename.c_str());
+
+	Report(name, settings, ns_per_sample);
+}
+
+//Benchmark a single module fed from the shared input.  With no output given
+//every output of the module is rendered
+template<typename M>
+void RunModule(const char* name, const BenchSettings& settings,
+	olc::sound::synth::Property M::* input, olc::sound::synth::Property M::* output,
+	std::function<void(M&)> configure = nullptr) {
+	Run(name, settings, [&]() -> BlockFunction {
+		//Shared so the module outlives this setup call, the heap keeps large modules off the stack
+		auto source = std::make_shared<BufferSource>();
+		auto module = std::make_shared<M>();
+		auto synth = std::make_shared<olc::sound::synth::ModularSynth>();
+		source->samples = settings.input;
+		if (configure) configure(*module);
+		synth->AddModule(source.get());
+		synth->AddModule(module.get());
+		if (input != nullptr) synth->AddPatch(&source->output, &((*module).*input));
+		if (output != nullptr) synth->AddOutput(&((*module).*output));
+		else for (auto& p : module->GetOutputs()) synth->AddOutput(p);
+		synth->Compile(settings.block_size);
+		return [source, module, synth](uint32_t nFrames, double dTime) {
+			synth->ProcessBlock(0, dTime, 1.0 / samplerate, nFrames);
+		};
+	});
+}
+
+//Benchmark the whole game patch with a bolt in progress
+template<typename T>
+void RunPatch(const char* name, const BenchSettings& settings) {
+	Run(name, settings, [&]() -> BlockFunction {
+		auto thunder = std::make_shared<ThunderPatch_generic<T>>();
+		thunder->synth.SetThreads(settings.threads);
+		thunder->synth.Compile(settings.block_size);
+		thunder->Prepare(0.5f, 1.3);
+		thunder->Strike();
+		return [thunder](uint32_t nFrames, double dTime) {
+			thunder->synth.ProcessBlock(0, dTime, 1.0 / samplerate, nFrames);
+		};
+	});
+}
+
+int main(int argc, char* argv[]) {
+	//Denormals are flushed on the audio thread, so measure the same way
+	olc::sound::ScopedFlushDenormals flush;
+
+	BenchSettings settings;
+	if (argc > 1) settings.seconds = std::atof(argv[1]);
+	if (argc > 2) settings.runs = std::max(1, std::atoi(argv[2]));
+	if (argc > 3) settings.block_size = std::max(1, std::atoi(argv[3]));
+	if (argc > 4) settings.seed = std::atoi(argv[4]);
+	if (argc > 5) settings.threads = std::max(1, std::atoi(argv[5]));
+
+	//One second of seeded white noise, looped
+	settings.input.resize(samplerate);
+	uint32_t state = settings.seed;
+	for (auto& s : settings.input) {
+		state = state * 1664525u + 1013904223u;
+		s = (state >> 8) / double(1 << 24) * 2.0 - 1.0;
+	}
+
+	using Oscillator = olc::sound::synth::modules::Oscillator;
+
+	printf("module,block_size,runs,ns_per_sample_mean,ns_per_sample_stddev,realtime_factor\n");
+
+	//The source alone, the overhead included in every module below
+	Run("BufferSource", settings, [&]() -> BlockFunction {
+		auto source = std::make_shared<BufferSource>();
+		auto synth = std::make_shared<olc::sound::synth::ModularSynth>();
+		source->samples = settings.input;
+		synth->AddModule(source.get());
+		synth->AddOutput(&source->output);
+		synth->Compile(settings.block_size);
+		return [source, synth](uint32_t nFrames, double dTime) {
+			synth->ProcessBlock(0, dTime, 1.0 / samplerate, nFrames);
+		};
+	});
+
+	RunModule<BiquadFilter>("BiquadFilter", settings, &BiquadFilter::input, &BiquadFilter::output, [](BiquadFilter& m) {
+		m.Configure(samplerate, 97, 20, 1, BiquadFilter::Type::LowPass);
+	});
+	RunModule<BiquadBank<5>>("BiquadBank_5", settings, &BiquadBank<5>::input, nullptr, [](BiquadBank<5>& m) {
+		const double fc[5] = { 23, 47, 61, 97, 113 };
+		for (size_t i = 0; i < 5; i++) {
+			m.Configure(i, samplerate, fc[i], 20, 1, BiquadBank<5>::Type::LowPass);
+		}
+	});
+	RunModule<BiquadCascade<4>>("BiquadCascade_4", settings, &BiquadCascade<4>::input, &BiquadCascade<4>::output, [](BiquadCascade<4>& m) {
+		for (size_t i = 0; i < 4; i++) {
+			m.Configure(i, samplerate, 2000, 0.707, 1, BiquadCascade<4>::Type::LowPass);
+		}
+	});
+	RunModule<LPF>("LPF", settings, &LPF::input, &LPF::output);
+	RunModule<FIR<255>>("FIR_255", settings, &FIR<255>::input, &FIR<255>::output, [](FIR<255>& m) {
+		m.Configure(samplerate, 80, FIR<255>::Type::HighPass);
+	});
+	RunModule<FIR<2047>>("FIR_2047", settings, &FIR<2047>::input, &FIR<2047>::output, [](FIR<2047>& m) {
+		m.Configure(samplerate, 80, FIR<2047>::Type::HighPass);
+	});
+	RunModule<DelayLine>("DelayLine", settings, &DelayLine::input, &DelayLine::output, [](DelayLine& m) {
+		m.SetMaxDelay(2.0, samplerate);
+		m.decay = .55;
+		m.delay = .5;
+	});
+	RunModule<Saturator>("Saturator", settings, &Saturator::input, &Saturator::output, [](Saturator& m) {
+		m.ceiling = 0.5;
+	});
+	RunModule<NanGuard>("NanGuard", settings, &NanGuard::input, &NanGuard::output);
+	RunModule<Pinkifier>("Pinkifier", settings, &Pinkifier::input, &Pinkifier::output);
+	RunModule<PinkNoise>("PinkNoise_Voss", settings, nullptr, &PinkNoise::output, [](PinkNoise& m) {
+		m.algorithm = PinkNoise::Algorithm::VossMcCartney;
+	});
+	RunModule<PinkNoise>("PinkNoise_FilterBank", settings, nullptr, &PinkNoise::output, [](PinkNoise& m) {
+		m.algorithm = PinkNoise::Algorithm::FilterBank;
+	});
+	RunModule<ADSREnvelope>("ADSREnvelope", settings, &ADSREnvelope::mInput, &ADSREnvelope::mOutput, [](ADSREnvelope& m) {
+		m.mAttack = 0.5;
+		m.mDecay = 0.5;
+		m.mSustain = 0.5;
+		m.mHold = 1.0;
+		m.mRelease = 5.0;
+		m.mCurve = ADSREnvelope::Curve::Exponential;
+		m.Begin();
+	});
+	RunModule<StrikeEnvelope>("StrikeEnvelope", settings, &StrikeEnvelope::input, &StrikeEnvelope::output, [](StrikeEnvelope& m) {
+		m.Trigger();
+	});
+	RunModule<LightningStrike>("LightningStrike", settings, nullptr, &LightningStrike::output, [](LightningStrike& m) {
+		m.SetLCount(6);
+		m.Trigger();
+	});
+	RunModule<Oscillator>("Oscillator_Sine", settings, nullptr, &Oscillator::output, [](Oscillator& m) {
+		m.waveform = Oscillator::Type::Sine;
+		m.frequency = 0.11 / 20000;
+	});
+	//The same sine run once every 64 frames and interpolated back to audio rate
+	Run("Oscillator_Sine_ControlRate", settings, [&]() -> BlockFunction {
+		auto osc = std::make_shared<Oscillator>();
+		auto synth = std::make_shared<olc::sound::synth::ModularSynth>();
+		osc->waveform = Oscillator::Type::Sine;
+		osc->frequency = 0.11 / 20000;
+		synth->AddModule(osc.get());
+		synth->AddOutput(&osc->output);
+		synth->SetControlRate(osc.get(), 64, olc::sound::synth::ModularSynth::Interpolation::Cubic);
+		synth->Compile(settings.block_size);
+		return [osc, synth](uint32_t nFrames, double dTime) {
+			synth->ProcessBlock(0, dTime, 1.0 / samplerate, nFrames);
+		};
+	});
+	RunModule<Oscillator>("Oscillator_PWM", settings, nullptr, &Oscillator::output, [](Oscillator& m) {
+		m.waveform = Oscillator::Type::PWM;
+		m.frequency = 1000.0 / 20000;
+		m.parameter = 0.9;
+	});
+	RunModule<Oscillator>("Oscillator_Noise", settings, nullptr, &Oscillator::output, [](Oscillator& m) {
+		m.waveform = Oscillator::Type::Noise;
+	});
+
+	//The whole game patch with a bolt in progress
+	RunPatch<double>("ThunderPatch_double", settings);
+	RunPatch<float>("ThunderPatch_float", settings);
+
+	//Wave playback, 16 voices
+	RunWaves("Waves16_Linear_x1.3", settings, olc::sound::wave::Quality::Linear, 1.3, false);
+	RunWaves("Waves16_Low_x1.3", settings, olc::sound::wave::Quality::Low, 1.3, false);
+	RunWaves("Waves16_Medium_x1.3", settings, olc::sound::wave::Quality::Medium, 1.3, false);
+	RunWaves("Waves16_High_x1.3", settings, olc::sound::wave::Quality::High, 1.3, false);
+	RunWaves("Waves16_Medium_x1", settings, olc::sound::wave::Quality::Medium, 1.0, false);
+	RunWaves("Waves16_Resampled_x1", settings, olc::sound::wave::Quality::High, 1.0, true);
+
+	//Loading the same length of audio from disk, stereo
+	RunLoad("LoadFile_8bit", settings, 1);
+	RunLoad("LoadFile_16bit", settings, 2);
+	RunLoad("LoadFile_24bit", settings, 3);
+	RunLoad("LoadFile_32bit", settings, 4);
+
+	return 0;
+}
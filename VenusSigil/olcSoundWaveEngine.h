@@ -161,13 +161,18 @@
 #include <cstring>
 #include <vector>
 #include <list>
+#include <array>
 #include <atomic>
+#include <chrono>
 #include <condition_variable>
 #include <mutex>
 #include <thread>
 #include <functional>
+#include <memory>
+#include <unordered_map>
 #include <string>
 #include <algorithm>
+#include <type_traits>
 #include <fstream>
 #include <iostream>
 
@@ -175,7 +180,7 @@
 #if !defined(SOUNDWAVE_USING_WINMM) && !defined(SOUNDWAVE_USING_WASAPI) &&  \
     !defined(SOUNDWAVE_USING_XAUDIO) && !defined(SOUNDWAVE_USING_OPENAL) && \
     !defined(SOUNDWAVE_USING_ALSA) && !defined(SOUNDWAVE_USING_SDLMIXER) && \
-    !defined(SOUNDWAVE_USING_PULSE)                                         \
+    !defined(SOUNDWAVE_USING_PULSE) && !defined(SOUNDWAVE_USING_OFFLINE)    \
 
 #if defined(_WIN32)
 #define SOUNDWAVE_USING_WINMM
@@ -192,11 +197,362 @@
 
 #endif
 
+// Denormal control, see ScopedFlushDenormals
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define SOUNDWAVE_DENORMALS_SSE
+#include <xmmintrin.h>
+#elif defined(__aarch64__) && (defined(__GNUC__) || defined(__clang__))
+#define SOUNDWAVE_DENORMALS_ARM64
+#endif
+
 namespace olc::sound
 {
+	// Treats denormal floats as zero on the calling thread for as long as it is
+	// in scope, then puts the old mode back. Filters decaying towards silence
+	// otherwise spend their tails on denormals, which cost 10-100x as much per
+	// operation on x86. Sets FTZ and DAZ with SSE and FZ on 64 bit ARM, and does
+	// nothing elsewhere, e.g. wasm has no such mode. The drivers hold one on
+	// their audio threads, as do the synth's worker threads.
+	class ScopedFlushDenormals
+	{
+	public:
+		ScopedFlushDenormals()
+		{
+#if defined(SOUNDWAVE_DENORMALS_SSE)
+			m_nSaved = _mm_getcsr();
+			// Flush to zero (bit 15) and denormals are zero (bit 6)
+			_mm_setcsr(uint32_t(m_nSaved) | 0x8040);
+#elif defined(SOUNDWAVE_DENORMALS_ARM64)
+			uint64_t nFPCR;
+			__asm__ __volatile__("mrs %0, fpcr" : "=r"(nFPCR));
+			m_nSaved = nFPCR;
+			// Flush to zero (bit 24), which covers inputs as well
+			__asm__ __volatile__("msr fpcr, %0" : : "r"(nFPCR | (uint64_t(1) << 24)));
+#endif
+		}
+
+		~ScopedFlushDenormals()
+		{
+#if defined(SOUNDWAVE_DENORMALS_SSE)
+			_mm_setcsr(uint32_t(m_nSaved));
+#elif defined(SOUNDWAVE_DENORMALS_ARM64)
+			__asm__ __volatile__("msr fpcr, %0" : : "r"(m_nSaved));
+#endif
+		}
+
+		ScopedFlushDenormals(const ScopedFlushDenormals&) = delete;
+		ScopedFlushDenormals& operator =(const ScopedFlushDenormals&) = delete;
+
+	private:
+		uint64_t m_nSaved = 0;
+	};
+
+
+	// Fixed size queue for handing items from exactly one thread to exactly one
+	// other. Neither side ever locks or allocates, so it is safe to drain on the
+	// audio thread. N must be a power of two.
+	template<typename T, size_t N>
+	class SPSCQueue
+	{
+		static_assert(N > 0 && (N & (N - 1)) == 0, "SPSCQueue size must be a power of two");
+
+	public:
+		// Producer side. Returns false if the queue is full
+		bool Push(const T& item)
+		{
+			const size_t nTail = m_nTail.load(std::memory_order_relaxed);
+			if (nTail - m_nHead.load(std::memory_order_acquire) == N)
+				return false;
+
+			m_vItems[nTail & (N - 1)] = item;
+			m_nTail.store(nTail + 1, std::memory_order_release);
+			return true;
+		}
+
+		// Consumer side. Returns false if the queue is empty
+		bool Pop(T& item)
+		{
+			const size_t nHead = m_nHead.load(std::memory_order_relaxed);
+			if (nHead == m_nTail.load(std::memory_order_acquire))
+				return false;
+
+			item = m_vItems[nHead & (N - 1)];
+			m_nHead.store(nHead + 1, std::memory_order_release);
+			return true;
+		}
+
+		bool Empty() const
+		{
+			return m_nHead.load(std::memory_order_acquire) == m_nTail.load(std::memory_order_acquire);
+		}
+
+		// Producer side. Items that can be pushed now, the consumer only adds to it
+		size_t Free() const
+		{
+			return N - (m_nTail.load(std::memory_order_relaxed) - m_nHead.load(std::memory_order_acquire));
+		}
+
+	private:
+		std::array<T, N> m_vItems{};
+		// Kept on separate cache lines so producer and consumer don't fight
+		alignas(64) std::atomic<size_t> m_nHead{ 0 };
+		alignas(64) std::atomic<size_t> m_nTail{ 0 };
+	};
 
 	namespace wave
 	{
+		// What a .WAV file holds and where its samples start, see ReadHeader()
+		struct Format
+		{
+			size_t nChannels = 0;
+			size_t nSampleRate = 0;
+			size_t nSampleSize = 0;
+			size_t nSamples = 0;
+			// IEEE float samples rather than integer PCM
+			bool bFloat = false;
+			std::streamoff nDataOffset = 0;
+		};
+
+		// Reads the RIFF chunks up to "data", leaving the stream at the first
+		// sample. Takes PCM of 1 to 4 bytes and float of 4 or 8, plain or as
+		// WAVE_FORMAT_EXTENSIBLE, and skips any other chunks. A data chunk that
+		// runs past the end of the file is cut to what is there. Returns false
+		// for anything else
+		inline bool ReadHeader(std::istream& is, Format& format)
+		{
+			auto Read = [&](void* pData, const size_t nBytes)
+			{
+				is.read((char*)pData, nBytes);
+				return size_t(is.gcount()) == nBytes;
+			};
+
+			char id[4];
+			uint32_t nChunkSize = 0;
+			if (!Read(id, 4) || strncmp(id, "RIFF", 4) != 0) return false;
+			if (!Read(&nChunkSize, 4)) return false; // Not Interested
+			if (!Read(id, 4) || strncmp(id, "WAVE", 4) != 0) return false;
+
+			struct WaveFormatHeader
+			{
+				uint16_t wFormatTag;         /* format type */
+				uint16_t nChannels;          /* number of channels (i.e. mono, stereo...) */
+				uint32_t nSamplesPerSec;     /* sample rate */
+				uint32_t nAvgBytesPerSec;    /* for buffer estimation */
+				uint16_t nBlockAlign;        /* block size of data */
+				uint16_t wBitsPerSample;     /* number of bits per sample of mono data */
+			};
+			static_assert(sizeof(WaveFormatHeader) == 16, "fmt chunk is 16 bytes before any extension");
+
+			WaveFormatHeader header{ 0 };
+			bool bHeader = false;
+
+			while (Read(id, 4) && Read(&nChunkSize, 4))
+			{
+				const std::streamoff nStart = is.tellg();
+
+				if (strncmp(id, "fmt ", 4) == 0)
+				{
+					if (nChunkSize < sizeof(WaveFormatHeader) || !Read(&header, sizeof(WaveFormatHeader)))
+						return false;
+
+					// WAVE_FORMAT_EXTENSIBLE keeps the real format in the first two
+					// bytes of its sub format GUID, after cbSize, valid bits and mask
+					if (header.wFormatTag == 0xFFFE)
+					{
+						uint8_t extension[10];
+						if (nChunkSize < sizeof(WaveFormatHeader) + 10 || !Read(extension, 10))
+							return false;
+						header.wFormatTag = uint16_t(extension[8] | (extension[9] << 8));
+					}
+
+					bHeader = true;
+				}
+				else if (strncmp(id, "data", 4) == 0)
+				{
+					if (!bHeader || header.nChannels == 0 || header.wBitsPerSample % 8 != 0)
+						return false;
+
+					format.nChannels = header.nChannels;
+					format.nSampleRate = header.nSamplesPerSec;
+					format.nSampleSize = header.wBitsPerSample >> 3;
+					format.bFloat = header.wFormatTag == 3;
+
+					const bool bPCM = header.wFormatTag == 1 && format.nSampleSize >= 1 && format.nSampleSize <= 4;
+					const bool bFloat = format.bFloat && (format.nSampleSize == 4 || format.nSampleSize == 8);
+					if (!bPCM && !bFloat)
+						return false;
+
+					// Writers that never finished, or files cut short, claim more than is there
+					is.seekg(0, std::ios::end);
+					const std::streamoff nEnd = is.tellg();
+					const size_t nBytes = std::min<size_t>(nChunkSize, size_t(std::max<std::streamoff>(nEnd - nStart, 0)));
+					is.seekg(nStart);
+
+					format.nSamples = nBytes / (format.nChannels * format.nSampleSize);
+					format.nDataOffset = nStart;
+					return bool(is);
+				}
+
+				// Skip the rest of the chunk, chunks are padded to an even length
+				is.seekg(nStart + std::streamoff(nChunkSize) + (nChunkSize & 1));
+			}
+
+			return false;
+		}
+
+		// Converts nCount little endian samples in a Format's encoding to values
+		// normalised the way File::SaveFile() writes them. One plain loop per
+		// encoding, with no calls or branches inside, so the compiler can
+		// vectorise each of them
+		template<typename T>
+		inline void ConvertSamples(const char* pBytes, const size_t nSampleSize, const bool bFloat, T* pOut, const size_t nCount)
+		{
+			const uint8_t* p = reinterpret_cast<const uint8_t*>(pBytes);
+
+			if (bFloat)
+			{
+				if (nSampleSize == 4)
+				{
+					for (size_t i = 0; i < nCount; i++)
+					{
+						float f;
+						std::memcpy(&f, p + 4 * i, 4);
+						pOut[i] = T(f);
+					}
+				}
+				else
+				{
+					for (size_t i = 0; i < nCount; i++)
+					{
+						double d;
+						std::memcpy(&d, p + 8 * i, 8);
+						pOut[i] = T(d);
+					}
+				}
+				return;
+			}
+
+			switch (nSampleSize)
+			{
+			case 1: // 8-bit is unsigned, centred on 128
+			{
+				const T fScale = T(1.0 / 127.0);
+				for (size_t i = 0; i < nCount; i++)
+					pOut[i] = T(int32_t(p[i]) - 128) * fScale;
+			}
+			break;
+
+			case 2:
+			{
+				const T fScale = T(1.0 / 32767.0);
+				for (size_t i = 0; i < nCount; i++)
+				{
+					int16_t s;
+					std::memcpy(&s, p + 2 * i, 2);
+					pOut[i] = T(s) * fScale;
+				}
+			}
+			break;
+
+			case 3: // 24-bit, moved to the top of 32 and shifted back down to sign extend
+			{
+				const T fScale = T(1.0 / 8388607.0);
+				for (size_t i = 0; i < nCount; i++)
+				{
+					const uint32_t u = (uint32_t(p[3 * i]) << 8) | (uint32_t(p[3 * i + 1]) << 16) | (uint32_t(p[3 * i + 2]) << 24);
+					pOut[i] = T(int32_t(u) >> 8) * fScale;
+				}
+			}
+			break;
+
+			case 4:
+			{
+				const T fScale = T(1.0 / 2147483647.0);
+				for (size_t i = 0; i < nCount; i++)
+				{
+					int32_t s;
+					std::memcpy(&s, p + 4 * i, 4);
+					pOut[i] = T(s) * fScale;
+				}
+			}
+			break;
+			}
+		}
+
+		// Writes the 44 byte header of a PCM .WAV holding nDataBytes of samples
+		inline void WriteHeader(std::ostream& os, const size_t nChannels, const size_t nSampleRate, const uint16_t nSampleSize, const uint32_t nDataBytes)
+		{
+			auto Write16 = [&](uint16_t n) { os.write((const char*)&n, sizeof(uint16_t)); };
+			auto Write32 = [&](uint32_t n) { os.write((const char*)&n, sizeof(uint32_t)); };
+
+			os.write("RIFF", 4);
+			Write32(36 + nDataBytes);
+			os.write("WAVE", 4);
+
+			// Wave description chunk
+			os.write("fmt ", 4);
+			Write32(16);
+			Write16(1); // PCM
+			Write16(uint16_t(nChannels));
+			Write32(uint32_t(nSampleRate));
+			Write32(uint32_t(nSampleRate * nChannels * nSampleSize));
+			Write16(uint16_t(nChannels * nSampleSize));
+			Write16(nSampleSize * 8);
+
+			os.write("data", 4);
+			Write32(nDataBytes);
+		}
+
+		// Writes nValues normalised samples as nSampleSize byte PCM
+		template<typename T>
+		inline void WriteSamples(std::ostream& os, const T* pSample, const size_t nValues, const uint16_t nSampleSize)
+		{
+			// Convert and write a chunk at a time, rather than one value per write
+			std::vector<uint8_t> vBytes(std::min<size_t>(nValues, 4096) * nSampleSize);
+			for (size_t nDone = 0; nDone < nValues;)
+			{
+				const size_t nChunk = std::min<size_t>(nValues - nDone, 4096);
+				uint8_t* pByte = vBytes.data();
+				for (size_t i = 0; i < nChunk; i++)
+				{
+					const double d = std::clamp(double(*pSample++), -1.0, 1.0);
+					switch (nSampleSize)
+					{
+					case 1:
+						*pByte++ = uint8_t(std::lround(d * 127.0) + 128);
+						break;
+
+					case 2:
+					{
+						int16_t s = int16_t(std::lround(d * 32767.0));
+						std::memcpy(pByte, &s, 2);
+						pByte += 2;
+					}
+					break;
+
+					case 3:
+					{
+						int32_t s = int32_t(std::lround(d * 8388607.0));
+						std::memcpy(pByte, &s, 3);
+						pByte += 3;
+					}
+					break;
+
+					case 4:
+					{
+						int32_t s = int32_t(std::llround(d * 2147483647.0));
+						std::memcpy(pByte, &s, 4);
+						pByte += 4;
+					}
+					break;
+					}
+				}
+
+				os.write((const char*)vBytes.data(), nChunk * nSampleSize);
+				nDone += nChunk;
+			}
+		}
+
 		// Physically represents a .WAV file, but the data is stored
 		// as normalised floating point values
 		template<class T = float>
@@ -259,107 +615,63 @@ namespace olc::sound
 				if (!ifs.is_open())
 					return false;
 
-				struct WaveFormatHeader
-				{
-					uint16_t wFormatTag;         /* format type */
-					uint16_t nChannels;          /* number of channels (i.e. mono, stereo...) */
-					uint32_t nSamplesPerSec;     /* sample rate */
-					uint32_t nAvgBytesPerSec;    /* for buffer estimation */
-					uint16_t nBlockAlign;        /* block size of data */
-					uint16_t wBitsPerSample;     /* number of bits per sample of mono data */
-				};
-
-				WaveFormatHeader header{ 0 };
-
 				m_pRawData.reset();
 
-				char dump[4];
-				ifs.read(dump, sizeof(uint8_t) * 4); // Read "RIFF"
-				if (strncmp(dump, "RIFF", 4) != 0) return false;
-
-				ifs.read(dump, sizeof(uint8_t) * 4); // Not Interested
-				ifs.read(dump, sizeof(uint8_t) * 4); // Read "WAVE"
-				if (strncmp(dump, "WAVE", 4) != 0) return false;
-
-				// Read Wave description chunk
-				ifs.read(dump, sizeof(uint8_t) * 4); // Read "fmt "
-				ifs.read(dump, sizeof(uint8_t) * 4); // Not Interested
-				ifs.read((char*)&header, sizeof(WaveFormatHeader)); // Read Wave Format Structure chunk
-
-				// Search for audio data chunk
-				int32_t nChunksize = 0;
-				ifs.read(dump, sizeof(uint8_t) * 4); // Read chunk header
-				ifs.read((char*)&nChunksize, sizeof(uint32_t)); // Read chunk size
-
-				while (strncmp(dump, "data", 4) != 0)
-				{
-					// Not audio data, so just skip it
-					ifs.seekg(nChunksize, std::ios::cur);
-					ifs.read(dump, sizeof(uint8_t) * 4); // Read next chunk header
-					ifs.read((char*)&nChunksize, sizeof(uint32_t)); // Read next chunk size
-				}
+				Format format;
+				if (!ReadHeader(ifs, format))
+					return false;
 
 				// Finally got to data, so read it all in and convert to float samples
-				m_nSampleSize = header.wBitsPerSample >> 3;
-				m_nSamples = nChunksize / (header.nChannels * m_nSampleSize);
-				m_nChannels = header.nChannels;
-				m_nSampleRate = header.nSamplesPerSec;
+				m_nSampleSize = format.nSampleSize;
+				m_nSamples = format.nSamples;
+				m_nChannels = format.nChannels;
+				m_nSampleRate = format.nSampleRate;
 				m_pRawData = std::make_unique<T[]>(m_nSamples * m_nChannels);
 				m_dDuration = double(m_nSamples) / double(m_nSampleRate);
 				m_dDurationInSamples = double(m_nSamples);
 
 				T* pSample = m_pRawData.get();
+				const size_t nValues = m_nSamples * m_nChannels;
 
-				// Read in audio data and normalise
-				for (long i = 0; i < m_nSamples; i++)
+				// Already in the right format, so read it straight in
+				if (format.bFloat && format.nSampleSize == sizeof(T) && std::is_floating_point<T>::value)
 				{
-					for (int c = 0; c < m_nChannels; c++)
-					{
-						switch (m_nSampleSize)
-						{
-						case 1:
-						{
-							int8_t s = 0;
-							ifs.read((char*)&s, sizeof(int8_t));
-							*pSample = T(s) / T(std::numeric_limits<int8_t>::max());
-						}
-						break;
-
-						case 2:
-						{
-							int16_t s = 0;
-							ifs.read((char*)&s, sizeof(int16_t));
-							*pSample = T(s) / T(std::numeric_limits<int16_t>::max());
-						}
-						break;
-
-						case 3: // 24-bit
-						{
-							int32_t s = 0;
-							ifs.read((char*)&s, 3);
-							if (s & (1 << 23)) s |= 0xFF000000;
-							*pSample = T(s) / T(std::pow(2, 23) - 1);
-						}
-						break;
-
-						case 4:
-						{
-							int32_t s = 0;
-							ifs.read((char*)&s, sizeof(int32_t));
-							*pSample = T(s) / T(std::numeric_limits<int32_t>::max());
-						}
-						break;
-						}
+					ifs.read((char*)pSample, std::streamsize(nValues * sizeof(T)));
+					return bool(ifs);
+				}
 
-						pSample++;
-					}
+				// Read in audio data a block at a time and normalise. Blocks small
+				// enough to stay in cache between the read and the conversion
+				const size_t nBlock = std::min<size_t>(nValues, 65536);
+				std::vector<char> vBytes(nBlock * format.nSampleSize);
+				for (size_t nDone = 0; nDone < nValues; nDone += nBlock)
+				{
+					const size_t nCount = std::min(nBlock, nValues - nDone);
+					if (!ifs.read(vBytes.data(), std::streamsize(nCount * format.nSampleSize)))
+						return false;
+					ConvertSamples(vBytes.data(), format.nSampleSize, format.bFloat, pSample + nDone, nCount);
 				}
 				return true;
 			}
 
+			// Saves as integer PCM using samplesize() bytes per sample, 1 to 4
+			// (anything else is saved as 16-bit). 8-bit files are unsigned, as the
+			// WAV format expects.
 			bool SaveFile(const std::string& sFilename)
 			{
-				return false;
+				if (m_pRawData == nullptr)
+					return false;
+
+				std::ofstream ofs(sFilename, std::ios::binary);
+				if (!ofs.is_open())
+					return false;
+
+				const uint16_t nSampleSize = (m_nSampleSize >= 1 && m_nSampleSize <= 4) ? uint16_t(m_nSampleSize) : 2;
+				const size_t nValues = m_nSamples * m_nChannels;
+
+				WriteHeader(ofs, m_nChannels, m_nSampleRate, nSampleSize, uint32_t(nValues * nSampleSize));
+				WriteSamples(ofs, m_pRawData.get(), nValues, nSampleSize);
+				return ofs.good();
 			}
 
 
@@ -373,9 +685,92 @@ namespace olc::sound
 			double m_dDurationInSamples = 0.0;
 		};
 
+		// Writes a PCM .WAV as it is produced, for audio too long to hold in a
+		// File. The header goes out first with the sizes left at 0, and Close()
+		// fills them in. WAV sizes are 32 bit, so Write() refuses anything that
+		// would take the file past 4GB
+		template<class T = float>
+		class FileWriter
+		{
+		public:
+			FileWriter() = default;
+			~FileWriter()
+			{
+				Close();
+			}
+
+			FileWriter(const FileWriter&) = delete;
+			FileWriter& operator =(const FileWriter&) = delete;
+
+		public:
+			bool Open(const std::string& sFilename, const size_t nChannels, const size_t nSampleSize, const size_t nSampleRate)
+			{
+				Close();
+
+				m_ofs.open(sFilename, std::ios::binary);
+				if (!m_ofs.is_open())
+					return false;
+
+				m_nChannels = nChannels;
+				m_nSampleSize = (nSampleSize >= 1 && nSampleSize <= 4) ? uint16_t(nSampleSize) : 2;
+				m_nSampleRate = nSampleRate;
+				m_nDataBytes = 0;
+				WriteHeader(m_ofs, m_nChannels, m_nSampleRate, m_nSampleSize, 0);
+				return m_ofs.good();
+			}
+
+			// Appends nFrames interleaved frames. False if the file isn't open, is
+			// full or couldn't be written
+			bool Write(const T* pSamples, const size_t nFrames)
+			{
+				const uint64_t nBytes = uint64_t(nFrames) * m_nChannels * m_nSampleSize;
+				if (!m_ofs.is_open() || 36 + m_nDataBytes + nBytes > UINT32_MAX)
+					return false;
+
+				WriteSamples(m_ofs, pSamples, nFrames * m_nChannels, m_nSampleSize);
+				m_nDataBytes += nBytes;
+				return m_ofs.good();
+			}
+
+			// Fills in the sizes in the header and closes the file
+			bool Close()
+			{
+				if (!m_ofs.is_open())
+					return false;
+
+				m_ofs.seekp(4);
+				const uint32_t nRiffBytes = uint32_t(36 + m_nDataBytes);
+				m_ofs.write((const char*)&nRiffBytes, sizeof(uint32_t));
+				m_ofs.seekp(40);
+				const uint32_t nDataBytes = uint32_t(m_nDataBytes);
+				m_ofs.write((const char*)&nDataBytes, sizeof(uint32_t));
+
+				const bool bGood = m_ofs.good();
+				m_ofs.close();
+				return bGood;
+			}
+
+			// Frames written so far
+			size_t frames() const
+			{
+				return m_nChannels > 0 ? size_t(m_nDataBytes / (m_nChannels * m_nSampleSize)) : 0;
+			}
+
+		protected:
+			std::ofstream m_ofs;
+			size_t m_nChannels = 0;
+			size_t m_nSampleRate = 0;
+			uint16_t m_nSampleSize = 2;
+			uint64_t m_nDataBytes = 0;
+		};
+
+		class Resampler;
+
 		template<typename T>
 		class View
 		{
+			friend class Resampler;
+
 		public:
 			View() = default;
 
@@ -406,6 +801,47 @@ namespace olc::sound
 				return a + t * (b - a); // std::lerp in C++20
 			}
 
+			// Adds GetSample(dSample + n * dStep) to pOut[n * nOutStride] for n < nFrames.
+			// While both neighbours are in range the bounds checks are skipped, which
+			// leaves a loop with nothing but the interpolation in it
+			void MixInto(float* pOut, const size_t nOutStride, const double dSample, const double dStep, const uint32_t nFrames) const
+			{
+				const T* pData = m_pData + m_nOffset;
+
+				// At whole samples and unity speed there is nothing to interpolate
+				if (dStep == 1.0 && dSample >= 0.0 && dSample == std::floor(dSample))
+				{
+					const size_t p = size_t(dSample);
+					const uint32_t nCopy = uint32_t(std::min<size_t>(nFrames, p < m_nSamples ? m_nSamples - p : 0));
+					for (uint32_t n = 0; n < nCopy; n++)
+						pOut[n * nOutStride] += float(pData[(p + n) * m_nStride]);
+					return;
+				}
+
+				// GetSample() needs no checks while floor(d) + 1 < m_nSamples
+				uint32_t nFast = 0;
+				const double dLast = double(m_nSamples) - 1.0;
+				if (dSample >= 0.0 && dStep > 0.0 && dSample < dLast)
+				{
+					nFast = uint32_t(std::min(double(nFrames), std::ceil((dLast - dSample) / dStep)));
+					while (nFast > 0 && dSample + (nFast - 1) * dStep >= dLast)
+						nFast--;
+				}
+
+				for (uint32_t n = 0; n < nFast; n++)
+				{
+					const double d = dSample + n * dStep;
+					const size_t p = size_t(d);
+					const double t = d - double(p);
+					const double a = pData[p * m_nStride];
+					const double b = pData[(p + 1) * m_nStride];
+					pOut[n * nOutStride] += float(a + t * (b - a));
+				}
+
+				for (uint32_t n = nFast; n < nFrames; n++)
+					pOut[n * nOutStride] += float(GetSample(dSample + n * dStep));
+			}
+
 			std::pair<double, double> GetRange(const double dSample1, const double dSample2) const
 			{
 				if (dSample1 < 0 || dSample2 < 0)
@@ -449,39 +885,196 @@ namespace olc::sound
 			size_t m_nStride = 1;
 			size_t m_nOffset = 0;
 		};
-	}
-
-	template<typename T = float>
-	class Wave_generic
-	{
-	public:
-		Wave_generic() = default;
-		Wave_generic(std::string sWavFile) { LoadAudioWaveform(sWavFile); }
-		Wave_generic(std::istream& sStream) { LoadAudioWaveform(sStream); }
-		Wave_generic(const char* pData, const size_t nBytes) { LoadAudioWaveform(pData, nBytes); }
 
-		Wave_generic(const size_t nChannels, const size_t nSampleSize, const size_t nSampleRate, const size_t nSamples)
-		{
-			vChannelView.clear();
-			file = wave::File<T>(nChannels, nSampleSize, nSampleRate, nSamples);
-			vChannelView.resize(file.channels());
-			for (uint32_t c = 0; c < file.channels(); c++)
-				vChannelView[c].SetData(file.data(), file.samples(), file.channels(), c);
-		}
+		// How PlayWaveform() and Wave_generic::Resample() interpolate. Linear is
+		// the two point interpolation of View::GetSample(), the others are
+		// Kaiser windowed sinc filters of 8, 16 and 32 taps
+		enum class Quality { Linear, Low, Medium, High };
 
-		bool LoadAudioWaveform(std::string sWavFile)
+		// Polyphase windowed sinc interpolation. The filter is tabulated at
+		// m_nPhases fractional positions between samples, and interpolated
+		// between the two nearest, so each output costs one pass over the taps.
+		// Build once off the audio thread, MixInto() only reads the table
+		class Resampler
 		{
-			vChannelView.clear();
-
-			if (file.LoadFile(sWavFile))
+		public:
+			// dCutoff is the highest frequency kept, as a fraction of the source's
+			// Nyquist frequency. Below 1 when the output has a lower sample rate
+			// than the source, so it can't alias
+			Resampler(const Quality eQuality = Quality::Medium, const double dCutoff = 1.0)
 			{
-				// Setup views for each channel
-				vChannelView.resize(file.channels());
-				for (uint32_t c = 0; c < file.channels(); c++)
-					vChannelView[c].SetData(file.data(), file.samples(), file.channels(), c);
+				m_eQuality = eQuality;
+				double dBeta = 0.0, dRolloff = 1.0;
+				switch (eQuality)
+				{
+				case Quality::Linear: return;
+				case Quality::Low: m_nTaps = 8; dBeta = 5.0; dRolloff = 0.80; break;
+				case Quality::Medium: m_nTaps = 16; dBeta = 7.0; dRolloff = 0.90; break;
+				case Quality::High: m_nTaps = 32; dBeta = 9.0; dRolloff = 0.95; break;
+				}
 
-				return true;
-			}
+				// Zeroth order modified Bessel function, for the Kaiser window
+				auto I0 = [](const double x)
+				{
+					double dSum = 1.0, dTerm = 1.0;
+					for (int k = 1; k < 50 && dTerm > dSum * 1e-12; k++)
+					{
+						dTerm *= (x / (2.0 * k)) * (x / (2.0 * k));
+						dSum += dTerm;
+					}
+					return dSum;
+				};
+
+				// Tap k of phase p sits k - (m_nTaps / 2 - 1) - p / m_nPhases samples from
+				// the output. One extra phase so the last can interpolate towards it
+				const double fc = std::min(dCutoff, 1.0) * dRolloff;
+				const double dHalf = m_nTaps / 2.0;
+				m_vTable.resize((m_nPhases + 1) * m_nTaps);
+				for (size_t p = 0; p <= m_nPhases; p++)
+				{
+					float* pTaps = &m_vTable[p * m_nTaps];
+					double dSum = 0.0;
+					for (size_t k = 0; k < m_nTaps; k++)
+					{
+						const double t = double(k) - (dHalf - 1.0) - double(p) / double(m_nPhases);
+						const double x = 3.14159265358979323846 * fc * t;
+						const double dSinc = (t == 0.0) ? 1.0 : std::sin(x) / x;
+						const double r = t / dHalf;
+						const double dWindow = (r * r < 1.0) ? I0(dBeta * std::sqrt(1.0 - r * r)) / I0(dBeta) : 0.0;
+						pTaps[k] = float(dSinc * dWindow);
+						dSum += pTaps[k];
+					}
+					// Unity gain at DC in every phase
+					for (size_t k = 0; k < m_nTaps; k++)
+						pTaps[k] = float(pTaps[k] / dSum);
+				}
+			}
+
+			Quality GetQuality() const
+			{
+				return m_eQuality;
+			}
+
+			// Adds the view interpolated at dSample + n * dStep to pOut[n * nOutStride]
+			// for n < nFrames, with the source zero outside its samples
+			template<typename T, typename U>
+			void MixInto(const View<T>& view, U* pOut, const size_t nOutStride, const double dSample, const double dStep, const uint32_t nFrames) const
+			{
+				switch (m_nTaps)
+				{
+				case 8: Mix<8>(view, pOut, nOutStride, dSample, dStep, nFrames); break;
+				case 16: Mix<16>(view, pOut, nOutStride, dSample, dStep, nFrames); break;
+				case 32: Mix<32>(view, pOut, nOutStride, dSample, dStep, nFrames); break;
+				default:
+					for (uint32_t n = 0; n < nFrames; n++)
+						pOut[n * nOutStride] += U(view.GetSample(dSample + n * dStep));
+					break;
+				}
+			}
+
+		private:
+			// The tap count known at compile time, so the inner loop unrolls
+			template<size_t N, typename T, typename U>
+			void Mix(const View<T>& view, U* pOut, const size_t nOutStride, const double dSample, const double dStep, const uint32_t nFrames) const
+			{
+				const T* pData = view.m_pData + view.m_nOffset;
+				const size_t nStride = view.m_nStride;
+				const size_t nSamples = view.m_nSamples;
+				constexpr size_t nBefore = N / 2 - 1;
+
+				for (uint32_t n = 0; n < nFrames; n++)
+				{
+					const double d = dSample + n * dStep;
+					if (d < 0.0)
+						continue;
+
+					const size_t i = size_t(d);
+					const double dPhase = (d - double(i)) * double(m_nPhases);
+					const size_t p = std::min(size_t(dPhase), m_nPhases - 1);
+					const float u = float(dPhase - double(p));
+					if (i >= nSamples + N)
+						continue;
+
+					// The filter at this fraction, between the two nearest phases
+					const float* h0 = &m_vTable[p * N];
+					const float* h1 = h0 + N;
+					float h[N];
+					for (size_t k = 0; k < N; k++)
+						h[k] = h0[k] + u * (h1[k] - h0[k]);
+
+					float x[N];
+					if (i >= nBefore && i + N - nBefore <= nSamples)
+					{
+						// All taps inside the source, mono sources are contiguous
+						const T* pX = pData + (i - nBefore) * nStride;
+						if (nStride == 1)
+						{
+							for (size_t k = 0; k < N; k++)
+								x[k] = float(pX[k]);
+						}
+						else
+						{
+							for (size_t k = 0; k < N; k++)
+								x[k] = float(pX[k * nStride]);
+						}
+					}
+					else
+					{
+						for (size_t k = 0; k < N; k++)
+						{
+							const size_t j = i + k;
+							x[k] = (j >= nBefore && j - nBefore < nSamples) ? float(pData[(j - nBefore) * nStride]) : 0.0f;
+						}
+					}
+
+					// Four partial sums rather than one serial chain of adds
+					float fAcc[4] = {};
+					for (size_t k = 0; k < N; k += 4)
+						for (size_t l = 0; l < 4; l++)
+							fAcc[l] += h[k + l] * x[k + l];
+					pOut[n * nOutStride] += U((fAcc[0] + fAcc[1]) + (fAcc[2] + fAcc[3]));
+				}
+			}
+
+		private:
+			static constexpr size_t m_nPhases = 256;
+			Quality m_eQuality = Quality::Linear;
+			size_t m_nTaps = 0;
+			std::vector<float> m_vTable;
+		};
+	}
+
+	template<typename T = float>
+	class Wave_generic
+	{
+	public:
+		Wave_generic() = default;
+		Wave_generic(std::string sWavFile) { LoadAudioWaveform(sWavFile); }
+		Wave_generic(std::istream& sStream) { LoadAudioWaveform(sStream); }
+		Wave_generic(const char* pData, const size_t nBytes) { LoadAudioWaveform(pData, nBytes); }
+
+		Wave_generic(const size_t nChannels, const size_t nSampleSize, const size_t nSampleRate, const size_t nSamples)
+		{
+			vChannelView.clear();
+			file = wave::File<T>(nChannels, nSampleSize, nSampleRate, nSamples);
+			vChannelView.resize(file.channels());
+			for (uint32_t c = 0; c < file.channels(); c++)
+				vChannelView[c].SetData(file.data(), file.samples(), file.channels(), c);
+		}
+
+		bool LoadAudioWaveform(std::string sWavFile)
+		{
+			vChannelView.clear();
+
+			if (file.LoadFile(sWavFile))
+			{
+				// Setup views for each channel
+				vChannelView.resize(file.channels());
+				for (uint32_t c = 0; c < file.channels(); c++)
+					vChannelView[c].SetData(file.data(), file.samples(), file.channels(), c);
+
+				return true;
+			}
 
 			return false;
 		}
@@ -491,24 +1084,181 @@ namespace olc::sound
 		bool LoadAudioWaveform(std::istream& sStream) { return false; }
 		bool LoadAudioWaveform(const char* pData, const size_t nBytes) { return false; }
 
+		// Converts the wave to nSampleRate, once, so it plays at that rate without
+		// any interpolation. Call after loading with WaveEngine::GetSampleRate(),
+		// then playing at normal speed is a straight copy
+		void Resample(const size_t nSampleRate, const wave::Quality eQuality = wave::Quality::High)
+		{
+			if (nSampleRate == 0 || nSampleRate == file.samplerate() || file.samples() == 0)
+				return;
+
+			const double dStep = double(file.samplerate()) / double(nSampleRate);
+			const size_t nSamples = size_t(std::ceil(double(file.samples()) / dStep));
+			wave::File<T> converted(file.channels(), file.samplesize(), nSampleRate, nSamples);
+			std::fill(converted.data(), converted.data() + nSamples * file.channels(), T(0));
+
+			// Going down in rate, everything above the new Nyquist frequency has to go
+			const wave::Resampler resampler(eQuality, 1.0 / std::max(dStep, 1.0));
+			for (uint32_t c = 0; c < file.channels(); c++)
+			{
+				if (eQuality == wave::Quality::Linear)
+				{
+					for (size_t n = 0; n < nSamples; n++)
+						converted.data()[n * file.channels() + c] = T(vChannelView[c].GetSample(n * dStep));
+				}
+				else
+					resampler.MixInto(vChannelView[c], converted.data() + c, file.channels(), 0.0, dStep, uint32_t(nSamples));
+			}
+
+			file = std::move(converted);
+			for (uint32_t c = 0; c < file.channels(); c++)
+				vChannelView[c].SetData(file.data(), file.samples(), file.channels(), c);
+		}
+
 		std::vector<wave::View<T>> vChannelView;
 		wave::File<T> file;
 	};
 
 	typedef Wave_generic<float> Wave;
 
+	// A .WAV file played straight from disk, for sounds too long to hold in
+	// memory. Only the header is read when it opens. A background thread then
+	// decodes m_nChunks chunks of nChunkFrames frames ahead of playback, and
+	// the audio thread takes them from a lock free ring, so it never waits on
+	// the disk and memory stays the same whatever the length of the file.
+	//
+	// Give it to WaveEngine::PlayWaveform(). It plays once at a time, from
+	// wherever it was left, see Seek(), or from the beginning if it last
+	// played to its end. Close() and the destructor take it back from the
+	// engine, waiting at most for the block being rendered.
+	class WaveEngine;
+
+	class WaveStream
+	{
+	public:
+		WaveStream() = default;
+		WaveStream(const std::string& sWavFile, const uint32_t nChunkFrames = 8192);
+		~WaveStream();
+
+		WaveStream(const WaveStream&) = delete;
+		WaveStream& operator =(const WaveStream&) = delete;
+
+	public:
+		// Opens the file and starts decoding from the beginning. Returns false
+		// without touching the stream while it is playing
+		bool Open(const std::string& sWavFile, const uint32_t nChunkFrames = 8192);
+		// Stops the stream if it is playing, then closes the file. Only waits
+		// for a block the engine is rendering right now
+		void Close();
+		bool IsOpen() const;
+		// From PlayWaveform() until the audio thread has let go of it
+		bool IsPlaying() const;
+
+		// Game thread. Playback continues from dTime seconds in as soon as the
+		// decoder catches up, with silence until then
+		void Seek(const double dTime);
+		// Game thread. Whether playback goes back to the start at the end of
+		// the file, PlayWaveform() sets it from bLoop
+		void SetLoop(const bool bLoop);
+
+		const wave::Format& GetFormat() const;
+		double Duration() const;
+		// Frames the audio thread played as silence because the decoder was behind
+		uint32_t Underruns() const;
+
+	private:
+		friend class WaveEngine;
+
+		// Audio thread. Adds nFrames frames to interleaved pOut, stepping dStep
+		// source frames per frame, and returns how many it made before the end
+		uint32_t MixInto(float* pOut, const uint32_t nOutChannels, const uint32_t nFrames, const double dStep);
+		// Audio thread. Moves on to the next frame, false at the end of the file
+		bool NextFrame();
+		// Audio thread. Drops whatever was being played, after a Seek()
+		void Restart();
+
+		void Decoder();
+
+	private:
+		static constexpr uint32_t m_nChunks = 8;
+
+		struct Chunk
+		{
+			uint32_t nFrames = 0;
+			// Seek() it was decoded for, older ones are thrown away
+			uint32_t nEpoch = 0;
+			// The file ends with this chunk
+			bool bLast = false;
+		};
+
+		wave::Format m_format;
+		std::string m_sFile;
+		uint32_t m_nChunkFrames = 0;
+		std::array<Chunk, m_nChunks> m_vChunks{};
+		// Interleaved frames, m_nChunkFrames per chunk
+		std::vector<float> m_vSamples;
+
+		// Chunk indices, filled ones go to the audio thread and come back empty
+		SPSCQueue<uint32_t, m_nChunks> m_qFilled;
+		SPSCQueue<uint32_t, m_nChunks> m_qEmpty;
+
+		// Audio thread only. The chunk being played, the frame in it, and the
+		// frames either side of the play position
+		uint32_t m_nChunk = m_nChunks;
+		uint32_t m_nFrame = 0;
+		uint32_t m_nEpoch = 0;
+		double m_dFraction = 0.0;
+		bool m_bEnded = false;
+		std::vector<float> m_vFrameA;
+		std::vector<float> m_vFrameB;
+
+		// Written by the game thread
+		std::atomic<uint32_t> m_nSeekEpoch{ 0 };
+		std::atomic<size_t> m_nSeekFrame{ 0 };
+		std::atomic<bool> m_bLoop{ false };
+		// Set by PlayWaveform() and cleared when the audio thread is done with it
+		std::atomic<bool> m_bPlaying{ false };
+		// The engine playing it, valid while m_bPlaying is set
+		WaveEngine* m_pEngine = nullptr;
+		// Set by Close(), MixInto() then plays nothing so the audio thread lets go
+		std::atomic<bool> m_bRelease{ false };
+		std::atomic<uint32_t> m_nUnderruns{ 0 };
+
+		std::thread m_thread;
+		std::atomic<bool> m_bQuit{ false };
+		std::mutex m_muxWake;
+		std::condition_variable m_cvWake;
+	};
+
 	struct WaveInstance
 	{
 		Wave* pWave = nullptr;
+		// Set instead of pWave for a wave played from disk
+		WaveStream* pStream = nullptr;
 		double dInstanceTime = 0.0;
 		double dDuration = 0.0;
 		double dSpeedModifier = 1.0;
+		// Where the next frame reads from, in samples of the wave
+		double dPosition = 0.0;
+		wave::Quality eQuality = wave::Quality::Linear;
 		bool bFinished = false;
 		bool bLoop = false;
 		bool bFlagForStop = false;
+		// Which pool slot it occupies, and the generation it was started with
+		uint32_t nSlot = 0;
+		uint32_t nGeneration = 0;
 	};
 
-	typedef std::list<WaveInstance>::iterator PlayingWave;
+	// Handle to a wave started by WaveEngine::PlayWaveform(). Slots in the pool
+	// are reused, the generation tells this wave apart from later ones in the
+	// same slot, so stopping a wave that already finished does nothing.
+	struct PlayingWave
+	{
+		uint32_t nSlot = UINT32_MAX;
+		uint32_t nGeneration = 0;
+
+		bool IsValid() const { return nSlot != UINT32_MAX; }
+	};
 
 	namespace driver
 	{
@@ -529,6 +1279,14 @@ namespace olc::sound
 		// Release Audio Hardware
 		bool DestroyAudio();
 
+		// Configure the engine to render without touching audio hardware, for
+		// example with SOUNDWAVE_USING_OFFLINE on machines with no sound card
+		bool InitialiseOffline(uint32_t nSampleRate = 44100, uint32_t nChannels = 1, uint32_t nBlockSamples = 512);
+
+		// Render the next nFrames of audio as fast as possible into vBuffer (interleaved,
+		// resized to fit). Only use while no audio device is pulling from the engine.
+		uint32_t RenderOffline(std::vector<float>& vBuffer, const uint32_t nFrames);
+
 		// Call to get the names of all the devices capable of audio output - DACs. An entry
 		// from the returned collection can be specified as the device to use in UseOutputDevice()
 		std::vector<std::string> GetOutputDevices();
@@ -548,23 +1306,73 @@ namespace olc::sound
 		void SetCallBack_SynthFunction(std::function<float(uint32_t, double)> func);
 		void SetCallBack_FilterFunction(std::function<float(uint32_t, double, float)> func);
 
+		// How block callbacks see a buffer of nChannels x nFrames samples. Interleaved
+		// puts frame n channel c at n * nChannels + c, the same as the output, so
+		// needs no copying. Planar puts it at c * nFrames + n
+		enum class BlockLayout { Interleaved, Planar };
+
+		// Called once per block with (pBuffer, nChannels, nFrames, dStartTime, dTimeStep).
+		// The synth fills pBuffer, which is added to the waves playing. The filter
+		// changes pBuffer in place. These run alongside the per sample callbacks
+		// above, which cost a call per sample and channel each.
+		typedef std::function<void(float*, uint32_t, uint32_t, double, double)> BlockFunction;
+		void SetCallBack_SynthBlock(BlockFunction func, BlockLayout eLayout = BlockLayout::Interleaved);
+		void SetCallBack_FilterBlock(BlockFunction func, BlockLayout eLayout = BlockLayout::Interleaved);
+
 	public:
 		void SetOutputVolume(const float fVolume);
 
 
 
+		// Most waves that can play at once
+		static constexpr uint32_t m_nMaxWaves = 128;
+
+		// How waves started from now on interpolate when they don't play at
+		// their own sample rate and normal speed. Wave_generic::Resample() avoids
+		// the cost for waves played at normal speed
+		void SetResampleQuality(const wave::Quality eQuality);
+
+		// Play and stop are queued for the audio thread, which picks them up at the
+		// start of its next block. Call them from one thread only, usually the game
+		// thread. PlayWaveform() returns an invalid handle if all m_nMaxWaves are
+		// in use or the queue is full.
 		PlayingWave PlayWaveform(Wave* pWave, bool bLoop = false, double dSpeed = 1.0);
+		// Also returns an invalid handle if pStream is closed or already playing.
+		// A stream that played to its end is rewound, otherwise it resumes
+		PlayingWave PlayWaveform(WaveStream* pStream, bool bLoop = false, double dSpeed = 1.0);
 		void StopWaveform(const PlayingWave& w);
 		void StopAll();
 
 	private:
 		uint32_t FillOutputBuffer(std::vector<float>& vBuffer, const uint32_t nBufferOffset, const uint32_t nRequiredSamples);
+		// Audio thread, FillOutputBuffer() for at most m_nBlockSamples frames,
+		// which m_vBlock was sized for when the engine was initialised
+		void FillBlock(float* pOut, const uint32_t nFrames);
+		// Audio thread, applies queued commands and removes finished waves
+		PlayingWave StartWave(const WaveInstance& wave);
+		void ApplyWaveCommands();
+		void RemoveFinishedWaves();
+		// Audio thread, adds every playing wave to nFrames of interleaved pOut
+		void MixWaves(float* pOut, const uint32_t nFrames);
+		// Game thread, from WaveStream::Close(). Returns once pStream is out of the mix
+		void ReleaseStream(WaveStream* pStream);
 
 	private:
 		std::unique_ptr<driver::Base> m_driver;
 		std::function<void(double)> m_funcNewSample;
 		std::function<float(uint32_t, double)> m_funcUserSynth;
 		std::function<float(uint32_t, double, float)> m_funcUserFilter;
+		BlockFunction m_funcSynthBlock;
+		BlockFunction m_funcFilterBlock;
+		BlockLayout m_eSynthLayout = BlockLayout::Interleaved;
+		BlockLayout m_eFilterLayout = BlockLayout::Interleaved;
+		// Audio thread, where block callbacks write when they can't use the output
+		std::vector<float> m_vBlock;
+		// Filters for each quality, built up front so the audio thread only reads them
+		wave::Quality m_eQuality = wave::Quality::Medium;
+		std::array<wave::Resampler, 4> m_vResamplers{ {
+			wave::Resampler(wave::Quality::Linear), wave::Resampler(wave::Quality::Low),
+			wave::Resampler(wave::Quality::Medium), wave::Resampler(wave::Quality::High) } };
 
 
 	private:
@@ -581,7 +1389,31 @@ namespace olc::sound
 		std::string m_sOutputDevice;
 
 	private:
-		std::list<WaveInstance> m_listWaves;
+		struct WaveCommand
+		{
+			enum class Type { Play, Stop, StopAll } eType = Type::Play;
+			WaveInstance wave;
+		};
+
+		// Whoever holds m_bWavesBusy. The playing waves are packed at the front of
+		// m_vWaves, m_vSlotWave maps a slot to its place there
+		std::array<WaveInstance, m_nMaxWaves> m_vWaves{};
+		uint32_t m_nWaves = 0;
+		std::array<uint32_t, m_nMaxWaves> m_vSlotWave{};
+
+		// Game thread only, the slots it may hand out and their generations
+		std::vector<uint32_t> m_vFreeSlots;
+		std::array<uint32_t, m_nMaxWaves> m_vSlotGeneration{};
+
+		// Commands go to the audio thread, slots of finished waves come back
+		SPSCQueue<WaveCommand, 256> m_qWaveCommands;
+		SPSCQueue<uint32_t, m_nMaxWaves> m_qFreedSlots;
+
+		// Held by whichever thread is working on the waves, the audio thread for
+		// each block or ReleaseStream() between blocks
+		std::atomic<bool> m_bWavesBusy{ false };
+		// Whoever holds m_bWavesBusy, the time the next block starts at
+		double m_dWavesTime = 0.0;
 
 	public:
 		uint32_t GetSampleRate() const;
@@ -593,6 +1425,7 @@ namespace olc::sound
 
 		// Friends, for access to FillOutputBuffer from Drivers
 		friend class driver::Base;
+		friend class WaveStream;
 
 	};
 
@@ -638,19 +1471,68 @@ namespace olc::sound
 
 	namespace synth
 	{
-		class Property
+		// The synth classes are templated on the type of sample that flows between
+		// modules. Property, Module, ModularSynth etc. name the build's choice,
+		// double unless SOUNDWAVE_SYNTH_FLOAT is defined, while the _generic
+		// versions stay available for both, e.g. to compare against double.
+#if defined(SOUNDWAVE_SYNTH_FLOAT)
+		typedef float Sample;
+#else
+		typedef double Sample;
+#endif
+
+		// A port of a module. Values are stored as given, nothing is clamped, so
+		// a module that has to stay within range (the output, say) saturates
+		// explicitly. State that is not a port, like a
+		// filter's history or a time in seconds, belongs in plain members.
+		template<typename T>
+		class Property_generic
 		{
 		public:
-			double value = 0.0f;
+			// Audio rate ports see a value per frame. Control rate ports are
+			// parameters: a patch into one is read once per block, just before the
+			// module runs, and the port never gets a block buffer of its own.
+			enum class Rate
+			{
+				Audio,
+				Control
+			};
+
+		public:
+			T value = T(0);
+
+			// Per-frame storage used during block processing. ModularSynth binds this
+			// when the property is patched, otherwise it stays nullptr and value is used
+			T* buffer = nullptr;
+
+			Rate rate = Rate::Audio;
 
 		public:
-			Property() = default;
-			Property(double f);
+			Property_generic() = default;
+			Property_generic(double f, Rate eRate = Rate::Audio);
+			// Copying a property copies its value and rate, never its buffer binding
+			Property_generic(const Property_generic& p);
 
 		public:
-			Property& operator =(const double f);
+			Property_generic& operator =(const double f);
+			Property_generic& operator =(const Property_generic& p);
+
+			// Value of this property at frame n of the current block
+			T operator[](const size_t n) const
+			{
+				return buffer != nullptr ? buffer[n] : value;
+			}
+
+			// Store the value for frame n of the current block (unclamped)
+			void Write(const size_t n, const T f)
+			{
+				value = f;
+				if (buffer != nullptr) buffer[n] = f;
+			}
 		};
 
+		typedef Property_generic<Sample> Property;
+
 
 		class Trigger
 		{
@@ -658,39 +1540,361 @@ namespace olc::sound
 		};
 
 
-		class Module
+		template<typename T>
+		class Module_generic;
+
+		// A parameter change or trigger posted from outside the audio thread. The synth
+		// applies it at the start of the first block that reaches dTime.
+		template<typename T>
+		struct Event_generic
+		{
+			// Synth time to apply at, anything in the past applies at the next block
+			double dTime = 0.0;
+			// Either a value to overwrite...
+			T* pTarget = nullptr;
+			// ...or a module to pass nEvent to, through Module::HandleEventAt()
+			Module_generic<T>* pModule = nullptr;
+			uint32_t nEvent = 0;
+			double dValue = 0.0;
+		};
+
+		typedef Event_generic<Sample> Event;
+
+
+		template<typename T>
+		class Module_generic
 		{
+		public:
+			typedef Property_generic<T> Property;
+
+		public:
+			Module_generic() = default;
+			// Modules hold pointers to their own ports, so they cannot be copied
+			Module_generic(const Module_generic&) = delete;
+			Module_generic& operator =(const Module_generic&) = delete;
+			virtual ~Module_generic() = default;
+
 		public:
 			virtual void Update(uint32_t nChannel, double dTime, double dTimeStep) = 0;
+
+			// Process nFrames consecutive samples. The default calls Update() once per
+			// frame, moving registered ports through their block buffers, so existing
+			// modules work unchanged. Override this to provide a faster block path.
+			virtual void ProcessBlock(uint32_t nChannel, double dStartTime, double dTimeStep, uint32_t nFrames);
+
+			// Called on the audio thread, between blocks, for events posted with
+			// ModularSynth::PostEvent(). What nEvent means is up to the module.
+			virtual void HandleEvent(uint32_t nEvent, double dValue);
+
+			// The event is due nFrame frames into the block about to run. The default
+			// calls HandleEvent(), acting on it at the start of the block. Override
+			// this to act on events at the exact frame they were posted for.
+			virtual void HandleEventAt(uint32_t nEvent, double dValue, uint32_t nFrame);
+
+			// Return internal state, like a filter's history, to silence. Called on
+			// the audio thread, e.g. to recover once a nan or infinity got loose.
+			// The default does nothing.
+			virtual void Reset();
+
+		public:
+			const std::vector<Property*>& GetInputs() const;
+			const std::vector<Property*>& GetOutputs() const;
+
+		protected:
+			// Modules declare their ports so the synth can give them block buffers
+			void RegisterInput(Property* pProperty);
+			void RegisterOutput(Property* pProperty);
+
+		private:
+			std::vector<Property*> m_vInputs;
+			std::vector<Property*> m_vOutputs;
+		};
+
+		typedef Module_generic<Sample> Module;
+
+
+		// Runs a small graph of dependent tasks on a fixed set of threads, the
+		// calling thread being one of them. Each thread keeps a queue of tasks that
+		// are ready to go, and steals from the other queues when its own runs dry.
+		// Idle threads spin briefly and then sleep until the next Run().
+		class WorkerPool
+		{
+		public:
+			// nThreads includes the caller, so 1 starts no threads of its own
+			WorkerPool(uint32_t nThreads);
+			~WorkerPool();
+
+		public:
+			// Size the queues for up to nTasks tasks, so Run() never allocates
+			void Reserve(size_t nTasks);
+			// Run every task once. vNext[i] lists the tasks waiting on task i and
+			// vWaitsOn[i] is how many tasks task i waits on. Returns when all are done.
+			void Run(const std::vector<std::vector<uint32_t>>& vNext, const std::vector<uint32_t>& vWaitsOn, void (*pfnTask)(void*, uint32_t), void* pContext);
+			uint32_t GetThreads() const;
+
+		private:
+			struct alignas(64) Queue
+			{
+				std::atomic_flag bLock = ATOMIC_FLAG_INIT;
+				std::vector<uint32_t> vTasks;
+				size_t nHead = 0;
+				size_t nTail = 0;
+			};
+
+			void Worker(uint32_t nQueue);
+			bool Execute(uint32_t nQueue);
+			void Push(uint32_t nQueue, uint32_t nTask);
+			bool Pop(uint32_t nQueue, uint32_t& nTask, bool bSteal);
+
+		private:
+			uint32_t m_nThreads = 1;
+			std::unique_ptr<Queue[]> m_pQueues;
+			std::unique_ptr<std::atomic<uint32_t>[]> m_pWaitsOn;
+			size_t m_nCapacity = 0;
+			std::vector<std::thread> m_vThreads;
+
+			// The graph being run
+			const std::vector<std::vector<uint32_t>>* m_pvNext = nullptr;
+			void (*m_pfnTask)(void*, uint32_t) = nullptr;
+			void* m_pContext = nullptr;
+			std::atomic<size_t> m_nRemaining{ 0 };
+
+			// Waking the workers
+			std::atomic<uint64_t> m_nEpoch{ 0 };
+			std::atomic<uint32_t> m_nSleeping{ 0 };
+			std::atomic<bool> m_bQuit{ false };
+			std::mutex m_muxWake;
+			std::condition_variable m_cvWake;
 		};
 
 
-		class ModularSynth
+		template<typename T>
+		class ModularSynth_generic
 		{
 		public:
-			ModularSynth();
+			typedef Property_generic<T> Property;
+			typedef Module_generic<T> Module;
+			typedef Event_generic<T> Event;
+
+		public:
+			ModularSynth_generic();
 
 		public:
 			bool AddModule(Module* pModule);
 			bool RemoveModule(Module* pModule);
 			bool AddPatch(Property* pInput, Property* pOutput);
 			bool RemovePatch(Property* pInput, Property* pOutput);
+			// Keep per-frame values for a property nothing is patched from, so the
+			// caller can read it with operator[] after ProcessBlock()
+			bool AddOutput(Property* pOutput);
+
+		public:
+			enum class Interpolation
+			{
+				Linear,
+				Cubic
+			};
+
+			// Run pModule once every nPeriod frames rather than every frame, for
+			// slow modulators like LFOs. It is stepped with Update() and a time step
+			// nPeriod times as long, reading its inputs at the frame it runs on, so
+			// each run gives the value for the end of its period. Its outputs reach
+			// audio rate inputs interpolated between those runs, Linear a frame late
+			// and Cubic (Catmull-Rom), far smoother, a period late. nPeriod 1 makes
+			// it an audio rate module again. Modules in a feedback loop always run at
+			// audio rate. Returns false if pModule has not been added.
+			bool SetControlRate(Module* pModule, uint32_t nPeriod, Interpolation eInterpolation = Interpolation::Linear);
 
 
 		public:
+			// Turn modules and patches into a dependency ordered execution plan, with
+			// block buffers for up to nMaxFrames. Called automatically when the graph
+			// has changed, but calling it up front keeps allocation off the audio thread.
+			void Compile(uint32_t nMaxFrames = 512);
+
+			// Patches are read directly by the compiled plan, so this is no longer
+			// required before Update(). Kept for existing code.
 			void UpdatePatches();
 			void Update(uint32_t nChannel, double dTime, double dTimeStep);
+			// Run every module over nFrames samples, starting at dStartTime
+			void ProcessBlock(uint32_t nChannel, double dStartTime, double dTimeStep, uint32_t nFrames);
+
+		public:
+			// Safe to call from one thread other than the audio thread, typically the
+			// game loop. Values land at the start of the block holding dTime (synth
+			// time, see GetTime()), events are told the frame dTime falls on, see
+			// Module::HandleEventAt(). Returns false if the event queue is full.
+			bool PostValue(Property* pTarget, double dValue, double dTime = 0.0);
+			bool PostValue(T* pTarget, double dValue, double dTime = 0.0);
+			bool PostEvent(Module* pModule, uint32_t nEvent, double dValue = 0.0, double dTime = 0.0);
+			// Posts that will fit in the event queue now, from the posting thread.
+			// Check it first when several posts must all go in or none
+			size_t EventSpace() const;
+
+			// Start time of the most recent block, safe to read from any thread
+			double GetTime() const;
+
+		public:
+			// Run independent parts of the graph on nThreads threads, the audio thread
+			// included, joining wherever one part feeds another. 1, the default, keeps
+			// everything on the audio thread, as does any value under emscripten.
+			// Call before audio starts, not from the audio thread.
+			void SetThreads(uint32_t nThreads);
+
+		private:
+			void RunStep(size_t nStep, uint32_t nChannel, double dStartTime, double dTimeStep, uint32_t nFrames);
+			void RunControlRate(size_t nControl, uint32_t nChannel, double dStartTime, double dTimeStep, uint32_t nFrames);
+			static void RunTask(void* pSynth, uint32_t nTask);
+			void ProcessLoop(size_t nStep, uint32_t nChannel, double dStartTime, double dTimeStep, uint32_t nFrames);
+			void ApplyEvents(double dStartTime, double dTimeStep, uint32_t nFrames);
+			void ApplyEvent(const Event& e, uint32_t nFrame);
 
 		protected:
 			std::vector<Module*> m_vModules;
 			std::vector<std::pair<Property*, Property*>> m_vPatches;
+			std::vector<Property*> m_vOutputs;
+
+		private:
+			// One entry of the execution plan: either a single module that processes
+			// whole blocks, or a feedback loop whose modules run frame by frame
+			struct Step
+			{
+				size_t nFirst = 0;
+				size_t nCount = 0;
+				bool bLoop = false;
+			};
+
+			// Compiled state, rebuilt whenever modules or patches change
+			bool m_bDirty = true;
+			uint32_t m_nBlockCapacity = 0;
+			std::vector<T> m_vBlockMemory;
+			std::vector<Property*> m_vBound;
+			std::vector<Module*> m_vPlan;
+			std::vector<Step> m_vSteps;
+			// Patches that go back against the plan order, read with a one sample delay
+			std::vector<std::pair<Property*, Property*>> m_vFeedback;
+			std::vector<size_t> m_vFeedbackStart;
+			// Patches into control rate ports, copied once per block before the
+			// step holding plan entry i runs, from m_vControlStart[i]
+			std::vector<std::pair<Property*, Property*>> m_vControl;
+			std::vector<size_t> m_vControlStart;
+			// Patches between ports no module declared, copied once per block
+			std::vector<std::pair<Property*, Property*>> m_vLoosePatches;
+
+			// Modules given to SetControlRate(), with where they are in their period
+			struct ControlRate
+			{
+				Module* pModule = nullptr;
+				uint32_t nPeriod = 1;
+				Interpolation eInterpolation = Interpolation::Linear;
+				// Frames left in the current period, and frames already done
+				uint32_t nLeft = 0;
+				uint32_t nDone = 0;
+				bool bPrimed = false;
+				// Per output, its last four values oldest first and the cubic in the
+				// fraction of the period, highest power first, that the period follows
+				std::vector<std::array<T, 4>> vHistory;
+				std::vector<std::array<T, 4>> vCurve;
+			};
+			std::vector<ControlRate> m_vControlRate;
+			// Index into m_vControlRate of each plan entry, or m_vControlRate.size()
+			std::vector<size_t> m_vPlanControlRate;
+
+			// Steps fused into tasks for the worker pool, following chains of steps
+			// that only feed each other. Task t runs m_vTaskSteps[m_vTaskStart[t]]
+			// up to m_vTaskStart[t + 1] in order.
+			std::unique_ptr<WorkerPool> m_pWorkers;
+			std::vector<size_t> m_vTaskSteps;
+			std::vector<size_t> m_vTaskStart;
+			std::vector<std::vector<uint32_t>> m_vTaskNext;
+			std::vector<uint32_t> m_vTaskWaitsOn;
+			// The block being processed, for the tasks
+			uint32_t m_nBlockChannel = 0;
+			double m_dBlockStart = 0.0;
+			double m_dBlockStep = 0.0;
+			uint32_t m_nBlockFrames = 0;
+
+			// Events travel from the game thread through the queue, and wait in
+			// m_vPendingEvents (audio thread only) if they are for a later block
+			SPSCQueue<Event, 256> m_qEvents;
+			std::vector<Event> m_vPendingEvents;
+			std::atomic<double> m_dTime{ 0.0 };
+		};
+
+		typedef ModularSynth_generic<Sample> ModularSynth;
+
+
+		// Counter based white noise. Value k of a stream hashes the k-th step of a
+		// Weyl sequence, so no value depends on the one before it and whole blocks
+		// are filled in loops the compiler can vectorise. The same seed and stream
+		// always give the same values, different streams are independent.
+		class NoiseGenerator
+		{
+		public:
+			NoiseGenerator(uint32_t nSeed = 0xB00B1E5, uint32_t nStream = 0);
+
+		public:
+			// Restart at nSeed, nStream picks one of 2^32 unrelated sequences.
+			// Different seeds on one stream are the same sequence offset in time
+			void Seed(uint32_t nSeed, uint32_t nStream = 0);
+			// The next value, the same as one value of Fill()
+			uint32_t Next();
+			// The next nCount values
+			void Fill(uint32_t* pData, size_t nCount);
+			// The next value spread uniformly over [dMin, dMax), the same as one
+			// value of FillUniform()
+			double NextUniform(double dMin = -1.0, double dMax = 1.0);
+			// The next nCount values spread uniformly over [dMin, dMax)
+			void FillUniform(double* pData, size_t nCount, double dMin = -1.0, double dMax = 1.0);
+			// Normally distributed values with mean 0, from pairs of uniform ones
+			void FillGaussian(double* pData, size_t nCount, double dSigma = 1.0);
+
+		private:
+			static uint32_t Hash(uint32_t n, uint32_t nKey);
+			static double ToUniform(uint32_t n, double dScale, double dMin);
+
+		private:
+			uint32_t m_nCounter = 0;
+			// Hash of the stream number, mixed into every counter value
+			uint32_t m_nKey = 0;
+			// Fill() works through chunks of this many values at a time
+			static constexpr size_t m_nChunk = 64;
+		};
+
+
+		// One period of a waveform, band limited at every octave of pitch. Level l
+		// keeps the first 512 >> l harmonics, Sample() picks the level with the
+		// most harmonics that all stay below Nyquist, so nothing aliases.
+		class Wavetable
+		{
+		public:
+			// fShape(t) is the waveform at t in [0, 1), it is only sampled here
+			Wavetable(const std::function<double(double)>& fShape);
+
+		public:
+			// The waveform at t in [0, 1) for an oscillator that moves dt periods
+			// per sample, interpolated linearly
+			double Sample(double t, double dt) const;
+			// t - floor(t), without the library call floor() is before SSE4.1
+			static double Wrap(double t);
+
+		private:
+			static constexpr size_t m_nSize = 2048;
+			static constexpr size_t m_nLevels = 10;
+			static constexpr size_t m_nHarmonics = 512;
+			// m_nLevels tables of m_nSize + 1 samples, the last repeats the first
+			std::vector<float> m_vTable;
 		};
 
 
 		namespace modules
 		{
-			class Oscillator : public Module
+			template<typename T>
+			class Oscillator_generic : public Module_generic<T>
 			{
+			public:
+				typedef Property_generic<T> Property;
+
 			public:
 				enum class Type
 				{
@@ -722,17 +1926,44 @@ namespace olc::sound
 			private:
 				double phase_acc = 0.0f;
 				double max_frequency = 20000.0;
-				uint32_t random_seed = 0xB00B1E5;
+				NoiseGenerator noise;
+				// The noise waveform has always spanned [-1, 3) and clipped at 1,
+				// the thunder is voiced around it
+				static constexpr double noise_min = -1.0;
+				static constexpr double noise_max = 3.0;
 
-				double rndDouble(double min, double max);
-				uint32_t rnd();
+				// Sine runs a cycle per unit of phase_acc, the others every 2 units.
+				// dStep is how far the phase moved to get here
+				double Shape(uint32_t nChannel, double dStep, double dParameter) const;
+				// Smooths a step at t = 0 over the samples either side of it
+				static double PolyBlep(double t, double dt);
+				static const Wavetable& SineTable();
+				static const Wavetable& TriangleTable();
 
 
 			public:
+				Oscillator_generic();
 				virtual void Update(uint32_t nChannel, double dTime, double dTimeStep) override;
+				virtual void ProcessBlock(uint32_t nChannel, double dStartTime, double dTimeStep, uint32_t nFrames) override;
+
+				// Restart the noise waveform, give each oscillator its own nStream
+				// for noise that is independent of the others
+				void Seed(uint32_t nSeed, uint32_t nStream = 0);
 
 			};
+
+			typedef Oscillator_generic<Sample> Oscillator;
 		}
+
+		// Built once, with the implementation
+		extern template class Property_generic<float>;
+		extern template class Property_generic<double>;
+		extern template class Module_generic<float>;
+		extern template class Module_generic<double>;
+		extern template class ModularSynth_generic<float>;
+		extern template class ModularSynth_generic<double>;
+		extern template class modules::Oscillator_generic<float>;
+		extern template class modules::Oscillator_generic<double>;
 	}
 
 
@@ -930,37 +2161,337 @@ namespace olc::sound::driver
 
 namespace olc::sound
 {
-	WaveEngine::WaveEngine()
+	WaveStream::WaveStream(const std::string& sWavFile, const uint32_t nChunkFrames)
 	{
-		m_sInputDevice = "NONE";
-		m_sOutputDevice = "DEFAULT";
+		Open(sWavFile, nChunkFrames);
+	}
 
-#if defined(SOUNDWAVE_USING_WINMM)
-		m_driver = std::make_unique<driver::WinMM>(this);
-#endif
+	WaveStream::~WaveStream()
+	{
+		Close();
+	}
 
-#if defined(SOUNDWAVE_USING_WASAPI)
-		m_driver = std::make_unique<driver::WASAPI>(this);
-#endif
+	bool WaveStream::Open(const std::string& sWavFile, const uint32_t nChunkFrames)
+	{
+		// The audio thread is still reading the buffers about to be replaced
+		if (IsPlaying())
+			return false;
 
-#if defined(SOUNDWAVE_USING_XAUDIO)
-		m_driver = std::make_unique<driver::XAudio>(this);
-#endif
+		Close();
 
-#if defined(SOUNDWAVE_USING_OPENAL)
-		m_driver = std::make_unique<driver::OpenAL>(this);
-#endif
+		std::ifstream ifs(sWavFile, std::ios::binary);
+		if (!ifs.is_open() || !wave::ReadHeader(ifs, m_format))
+		{
+			m_format = {};
+			return false;
+		}
 
-#if defined(SOUNDWAVE_USING_ALSA)
-		m_driver = std::make_unique<driver::ALSA>(this);
-#endif
+		m_sFile = sWavFile;
+		m_nChunkFrames = std::max(nChunkFrames, 1u);
+		m_vSamples.assign(size_t(m_nChunks) * m_nChunkFrames * m_format.nChannels, 0.0f);
+		m_vFrameA.assign(m_format.nChannels, 0.0f);
+		m_vFrameB.assign(m_format.nChannels, 0.0f);
+
+		// Nothing else is running, so every chunk can go back to the decoder
+		uint32_t nChunk;
+		while (m_qFilled.Pop(nChunk));
+		while (m_qEmpty.Pop(nChunk));
+		for (nChunk = 0; nChunk < m_nChunks; nChunk++)
+			m_qEmpty.Push(nChunk);
+		m_nChunk = m_nChunks;
+		m_nUnderruns = 0;
+		m_bRelease = false;
+
+		// Start from the beginning, the audio thread picks this up like a Seek()
+		m_nSeekFrame = 0;
+		m_nSeekEpoch.fetch_add(1, std::memory_order_release);
+
+		m_thread = std::thread(&WaveStream::Decoder, this);
+		return true;
+	}
 
-#if defined(SOUNDWAVE_USING_SDLMIXER)
-		m_driver = std::make_unique<driver::SDLMixer>(this);
-#endif
+	void WaveStream::Close()
+	{
+		// Nothing can be freed while the audio thread might still be mixing it.
+		// If the engine went first it let go of every stream as it stopped
+		m_bRelease = true;
+		if (IsPlaying())
+			m_pEngine->ReleaseStream(this);
 
-#if defined(SOUNDWAVE_USING_PULSE)
-		m_driver = std::make_unique<driver::PulseAudio>(this);
+		if (!m_thread.joinable())
+			return;
+
+		{
+			std::lock_guard<std::mutex> lock(m_muxWake);
+			m_bQuit = true;
+		}
+		m_cvWake.notify_all();
+		m_thread.join();
+		m_bQuit = false;
+		m_format = {};
+	}
+
+	bool WaveStream::IsOpen() const
+	{
+		return m_thread.joinable();
+	}
+
+	bool WaveStream::IsPlaying() const
+	{
+		return m_bPlaying;
+	}
+
+	void WaveStream::Seek(const double dTime)
+	{
+		m_nSeekFrame = size_t(std::max(dTime, 0.0) * double(m_format.nSampleRate));
+		{
+			std::lock_guard<std::mutex> lock(m_muxWake);
+			m_nSeekEpoch.fetch_add(1, std::memory_order_release);
+		}
+		m_cvWake.notify_all();
+	}
+
+	void WaveStream::SetLoop(const bool bLoop)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_muxWake);
+			m_bLoop = bLoop;
+		}
+		m_cvWake.notify_all();
+	}
+
+	const wave::Format& WaveStream::GetFormat() const
+	{
+		return m_format;
+	}
+
+	double WaveStream::Duration() const
+	{
+		return m_format.nSampleRate > 0 ? double(m_format.nSamples) / double(m_format.nSampleRate) : 0.0;
+	}
+
+	uint32_t WaveStream::Underruns() const
+	{
+		return m_nUnderruns;
+	}
+
+	void WaveStream::Decoder()
+	{
+		std::ifstream ifs(m_sFile, std::ios::binary);
+		const size_t nChannels = m_format.nChannels;
+		const size_t nFrameBytes = nChannels * m_format.nSampleSize;
+		std::vector<char> vBytes(m_nChunkFrames * nFrameBytes);
+
+		// Next frame to decode, and where the file is at
+		size_t nPos = 0;
+		size_t nFilePos = SIZE_MAX;
+		uint32_t nEpoch = m_nSeekEpoch.load(std::memory_order_acquire) - 1;
+		bool bDone = true;
+
+		while (!m_bQuit)
+		{
+			const uint32_t nSeek = m_nSeekEpoch.load(std::memory_order_acquire);
+			if (nSeek != nEpoch)
+			{
+				nEpoch = nSeek;
+				nPos = std::min<size_t>(m_nSeekFrame, m_format.nSamples);
+				bDone = false;
+			}
+
+			// Looping was turned on after the end of the file was decoded
+			if (bDone && m_bLoop && nPos >= m_format.nSamples)
+			{
+				nPos = 0;
+				bDone = false;
+			}
+
+			uint32_t nChunk;
+			if (bDone || !m_qEmpty.Pop(nChunk))
+			{
+				// The audio thread doesn't signal, so look again shortly
+				std::unique_lock<std::mutex> lock(m_muxWake);
+				m_cvWake.wait_for(lock, std::chrono::milliseconds(5), [&] { return m_bQuit || m_nSeekEpoch.load() != nEpoch || (bDone && m_bLoop); });
+				continue;
+			}
+
+			Chunk& chunk = m_vChunks[nChunk];
+			float* pSamples = m_vSamples.data() + size_t(nChunk) * m_nChunkFrames * nChannels;
+			uint32_t nFrames = 0;
+			chunk.bLast = false;
+			while (nFrames < m_nChunkFrames)
+			{
+				if (nPos >= m_format.nSamples)
+				{
+					if (m_bLoop && m_format.nSamples > 0)
+						nPos = 0;
+					else
+					{
+						chunk.bLast = true;
+						bDone = true;
+						break;
+					}
+				}
+
+				const size_t nRead = std::min<size_t>(m_nChunkFrames - nFrames, m_format.nSamples - nPos);
+				if (nFilePos != nPos)
+				{
+					ifs.clear();
+					ifs.seekg(m_format.nDataOffset + std::streamoff(nPos * nFrameBytes));
+				}
+				ifs.read(vBytes.data(), nRead * nFrameBytes);
+
+				// A file shorter than its header says plays silence for the rest
+				const size_t nGot = size_t(std::max<std::streamsize>(ifs.gcount(), 0));
+				std::fill(vBytes.begin() + std::min(nGot, nRead * nFrameBytes), vBytes.begin() + nRead * nFrameBytes, char(0));
+
+				wave::ConvertSamples(vBytes.data(), m_format.nSampleSize, m_format.bFloat, pSamples + size_t(nFrames) * nChannels, nRead * nChannels);
+
+				nFrames += uint32_t(nRead);
+				nPos += nRead;
+				nFilePos = nGot == nRead * nFrameBytes ? nPos : SIZE_MAX;
+			}
+
+			chunk.nFrames = nFrames;
+			chunk.nEpoch = nEpoch;
+			m_qFilled.Push(nChunk);
+		}
+	}
+
+	void WaveStream::Restart()
+	{
+		if (m_nChunk != m_nChunks)
+			m_qEmpty.Push(m_nChunk);
+		m_nChunk = m_nChunks;
+		m_nEpoch = m_nSeekEpoch.load(std::memory_order_acquire);
+		m_bEnded = false;
+		std::fill(m_vFrameA.begin(), m_vFrameA.end(), 0.0f);
+		std::fill(m_vFrameB.begin(), m_vFrameB.end(), 0.0f);
+		// Two frames are read before the first one plays
+		m_dFraction = 2.0;
+	}
+
+	bool WaveStream::NextFrame()
+	{
+		if (m_bEnded)
+			return false;
+
+		std::swap(m_vFrameA, m_vFrameB);
+
+		// Find a chunk with frames left in it
+		while (m_nChunk == m_nChunks || m_nFrame >= m_vChunks[m_nChunk].nFrames)
+		{
+			if (m_nChunk != m_nChunks)
+			{
+				const bool bLast = m_vChunks[m_nChunk].bLast;
+				m_qEmpty.Push(m_nChunk);
+				m_nChunk = m_nChunks;
+
+				// The last frame fades to silence as if the file went on, like wave::View.
+				// If looping was turned on since, the decoder has gone back to the start
+				if (bLast && !m_bLoop)
+				{
+					m_bEnded = true;
+					std::fill(m_vFrameB.begin(), m_vFrameB.end(), 0.0f);
+					return true;
+				}
+			}
+
+			uint32_t nChunk;
+			if (!m_qFilled.Pop(nChunk))
+			{
+				// The decoder is behind, wait in silence rather than skip
+				m_nUnderruns++;
+				std::fill(m_vFrameB.begin(), m_vFrameB.end(), 0.0f);
+				return true;
+			}
+
+			if (m_vChunks[nChunk].nEpoch != m_nEpoch)
+				m_qEmpty.Push(nChunk);
+			else
+			{
+				m_nChunk = nChunk;
+				m_nFrame = 0;
+			}
+		}
+
+		const float* pFrame = m_vSamples.data() + (size_t(m_nChunk) * m_nChunkFrames + m_nFrame) * m_format.nChannels;
+		std::copy(pFrame, pFrame + m_format.nChannels, m_vFrameB.begin());
+		m_nFrame++;
+		return true;
+	}
+
+	uint32_t WaveStream::MixInto(float* pOut, const uint32_t nOutChannels, const uint32_t nFrames, const double dStep)
+	{
+		// Closing, end here so the engine lets go of the stream
+		if (m_bRelease)
+			return 0;
+
+		if (m_nSeekEpoch.load(std::memory_order_acquire) != m_nEpoch)
+			Restart();
+
+		const size_t nChannels = m_format.nChannels;
+		for (uint32_t n = 0; n < nFrames; n++)
+		{
+			while (m_dFraction >= 1.0)
+			{
+				if (!NextFrame())
+					return n;
+				m_dFraction -= 1.0;
+			}
+
+			const float t = float(m_dFraction);
+			for (uint32_t c = 0; c < nOutChannels; c++)
+			{
+				const float a = m_vFrameA[c % nChannels];
+				const float b = m_vFrameB[c % nChannels];
+				pOut[n * nOutChannels + c] += a + t * (b - a);
+			}
+			m_dFraction += dStep;
+		}
+		return nFrames;
+	}
+
+	WaveEngine::WaveEngine()
+	{
+		m_sInputDevice = "NONE";
+		m_sOutputDevice = "DEFAULT";
+
+		// Slot 0 is handed out first
+		m_vFreeSlots.reserve(m_nMaxWaves);
+		for (uint32_t n = m_nMaxWaves; n > 0; n--)
+			m_vFreeSlots.push_back(n - 1);
+
+#if defined(SOUNDWAVE_USING_WINMM)
+		m_driver = std::make_unique<driver::WinMM>(this);
+#endif
+
+#if defined(SOUNDWAVE_USING_WASAPI)
+		m_driver = std::make_unique<driver::WASAPI>(this);
+#endif
+
+#if defined(SOUNDWAVE_USING_XAUDIO)
+		m_driver = std::make_unique<driver::XAudio>(this);
+#endif
+
+#if defined(SOUNDWAVE_USING_OPENAL)
+		m_driver = std::make_unique<driver::OpenAL>(this);
+#endif
+
+#if defined(SOUNDWAVE_USING_ALSA)
+		m_driver = std::make_unique<driver::ALSA>(this);
+#endif
+
+#if defined(SOUNDWAVE_USING_SDLMIXER)
+		m_driver = std::make_unique<driver::SDLMixer>(this);
+#endif
+
+#if defined(SOUNDWAVE_USING_PULSE)
+		m_driver = std::make_unique<driver::PulseAudio>(this);
+#endif
+
+#if defined(SOUNDWAVE_USING_OFFLINE)
+		// No hardware at all, audio is only produced by RenderOffline()
+		m_driver = std::make_unique<driver::Base>(this);
 #endif
 	}
 
@@ -998,6 +2529,7 @@ namespace olc::sound
 		m_nBlockSamples = nBlockSamples;
 		m_dSamplePerTime = double(nSampleRate);
 		m_dTimePerSample = 1.0 / double(nSampleRate);
+		m_vBlock.resize(size_t(nBlockSamples) * nChannels);
 		m_driver->Open(m_sOutputDevice, m_sInputDevice);
 		m_driver->Start();
 		return false;
@@ -1009,9 +2541,46 @@ namespace olc::sound
 		StopAll();
 		m_driver->Stop();
 		m_driver->Close();
+
+		// The audio thread has stopped, let go of every wave here so streams
+		// can be closed, even if StopAll() found the queue full
+		ApplyWaveCommands();
+		for (uint32_t n = 0; n < m_nWaves; n++)
+			m_vWaves[n].bFlagForStop = true;
+		RemoveFinishedWaves();
 		return false;
 	}
 
+	bool WaveEngine::InitialiseOffline(uint32_t nSampleRate, uint32_t nChannels, uint32_t nBlockSamples)
+	{
+		m_nSampleRate = nSampleRate;
+		m_nChannels = nChannels;
+		m_nBlockSamples = nBlockSamples;
+		m_dSamplePerTime = double(nSampleRate);
+		m_dTimePerSample = 1.0 / double(nSampleRate);
+		m_dGlobalTime = 0.0;
+		m_vBlock.resize(size_t(nBlockSamples) * nChannels);
+		return true;
+	}
+
+	uint32_t WaveEngine::RenderOffline(std::vector<float>& vBuffer, const uint32_t nFrames)
+	{
+		if (vBuffer.size() < size_t(nFrames) * m_nChannels)
+			vBuffer.resize(size_t(nFrames) * m_nChannels);
+
+		// Rendered as the audio thread would, without changing the caller's mode for good
+		ScopedFlushDenormals flush;
+
+		// Same block size as a device would ask for, so callbacks see the same pattern
+		uint32_t nFrameOffset = 0;
+		while (nFrameOffset < nFrames)
+		{
+			const uint32_t nBlock = std::min(m_nBlockSamples, nFrames - nFrameOffset);
+			nFrameOffset += FillOutputBuffer(vBuffer, nFrameOffset * m_nChannels, nBlock);
+		}
+		return nFrames;
+	}
+
 	void WaveEngine::SetCallBack_NewSample(std::function<void(double)> func)
 	{
 		m_funcNewSample = func;
@@ -1027,6 +2596,18 @@ namespace olc::sound
 		m_funcUserFilter = func;
 	}
 
+	void WaveEngine::SetCallBack_SynthBlock(BlockFunction func, BlockLayout eLayout)
+	{
+		m_funcSynthBlock = func;
+		m_eSynthLayout = eLayout;
+	}
+
+	void WaveEngine::SetCallBack_FilterBlock(BlockFunction func, BlockLayout eLayout)
+	{
+		m_funcFilterBlock = func;
+		m_eFilterLayout = eLayout;
+	}
+
 	PlayingWave WaveEngine::PlayWaveform(Wave* pWave, bool bLoop, double dSpeed)
 	{
 		WaveInstance wi;
@@ -1034,360 +2615,1786 @@ namespace olc::sound
 		wi.pWave = pWave;
 		wi.dSpeedModifier = dSpeed * double(pWave->file.samplerate()) / m_dSamplePerTime;
 		wi.dDuration = pWave->file.duration() / dSpeed;
-		wi.dInstanceTime = m_dGlobalTime;
-		m_listWaves.push_back(wi);
-		return std::prev(m_listWaves.end());
+		wi.eQuality = m_eQuality;
+		return StartWave(wi);
+	}
+
+	PlayingWave WaveEngine::PlayWaveform(WaveStream* pStream, bool bLoop, double dSpeed)
+	{
+		if (!pStream->IsOpen() || pStream->m_bPlaying.exchange(true))
+			return {};
+		pStream->m_pEngine = this;
+
+		// The audio thread let go of the stream before m_bPlaying cleared, so
+		// m_bEnded can be read here. Having played to its end, it starts again
+		if (pStream->m_bEnded)
+			pStream->Seek(0.0);
+
+		pStream->SetLoop(bLoop);
+
+		WaveInstance wi;
+		wi.bLoop = bLoop;
+		wi.pStream = pStream;
+		wi.dSpeedModifier = dSpeed * double(pStream->GetFormat().nSampleRate) / m_dSamplePerTime;
+		wi.dDuration = pStream->Duration() / dSpeed;
+		PlayingWave w = StartWave(wi);
+		if (!w.IsValid())
+			pStream->m_bPlaying = false;
+		return w;
+	}
+
+	PlayingWave WaveEngine::StartWave(const WaveInstance& wave)
+	{
+		// Take back the slots of waves the audio thread has finished with
+		uint32_t nFreed;
+		while (m_qFreedSlots.Pop(nFreed))
+			m_vFreeSlots.push_back(nFreed);
+
+		if (m_vFreeSlots.empty())
+			return {};
+
+		WaveCommand cmd;
+		cmd.eType = WaveCommand::Type::Play;
+		cmd.wave = wave;
+		cmd.wave.nSlot = m_vFreeSlots.back();
+		cmd.wave.nGeneration = m_vSlotGeneration[cmd.wave.nSlot] + 1;
+		if (!m_qWaveCommands.Push(cmd))
+			return {};
+
+		m_vFreeSlots.pop_back();
+		m_vSlotGeneration[cmd.wave.nSlot] = cmd.wave.nGeneration;
+		return { cmd.wave.nSlot, cmd.wave.nGeneration };
+	}
+
+	void WaveEngine::StopWaveform(const PlayingWave& w)
+	{
+		if (!w.IsValid())
+			return;
+
+		WaveCommand cmd;
+		cmd.eType = WaveCommand::Type::Stop;
+		cmd.wave.nSlot = w.nSlot;
+		cmd.wave.nGeneration = w.nGeneration;
+		m_qWaveCommands.Push(cmd);
+	}
+
+	void WaveEngine::StopAll()
+	{
+		WaveCommand cmd;
+		cmd.eType = WaveCommand::Type::StopAll;
+		m_qWaveCommands.Push(cmd);
+	}
+
+	void WaveEngine::SetResampleQuality(const wave::Quality eQuality)
+	{
+		m_eQuality = eQuality;
+	}
+
+	void WaveEngine::ApplyWaveCommands()
+	{
+		WaveCommand cmd;
+		while (m_qWaveCommands.Pop(cmd))
+		{
+			switch (cmd.eType)
+			{
+			case WaveCommand::Type::Play:
+				// Waves start with the block, as they did when added between blocks
+				cmd.wave.dInstanceTime = m_dWavesTime;
+				cmd.wave.dPosition = 0.0;
+				m_vSlotWave[cmd.wave.nSlot] = m_nWaves;
+				m_vWaves[m_nWaves++] = cmd.wave;
+				break;
+
+			case WaveCommand::Type::Stop:
+			{
+				// Only if the slot still holds the wave the handle was made for
+				const uint32_t nWave = m_vSlotWave[cmd.wave.nSlot];
+				if (nWave < m_nWaves && m_vWaves[nWave].nSlot == cmd.wave.nSlot && m_vWaves[nWave].nGeneration == cmd.wave.nGeneration)
+					m_vWaves[nWave].bFlagForStop = true;
+				break;
+			}
+
+			case WaveCommand::Type::StopAll:
+				for (uint32_t n = 0; n < m_nWaves; n++)
+					m_vWaves[n].bFlagForStop = true;
+				break;
+			}
+		}
+	}
+
+	void WaveEngine::ReleaseStream(WaveStream* pStream)
+	{
+		while (pStream->IsPlaying())
+		{
+			if (m_bWavesBusy.exchange(true, std::memory_order_acquire))
+			{
+				// A block is being rendered, it ends the stream, see WaveStream::MixInto()
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+				continue;
+			}
+
+			// No block is running, and none touches the waves until they are
+			// handed back, so do here what the audio thread would have done
+			ApplyWaveCommands();
+			for (uint32_t n = 0; n < m_nWaves; n++)
+			{
+				if (m_vWaves[n].pStream == pStream)
+					m_vWaves[n].bFlagForStop = true;
+			}
+			RemoveFinishedWaves();
+			m_bWavesBusy.store(false, std::memory_order_release);
+		}
+	}
+
+	void WaveEngine::RemoveFinishedWaves()
+	{
+		// Swap the last wave into each hole, order doesn't matter to the mix
+		uint32_t n = 0;
+		while (n < m_nWaves)
+		{
+			if (m_vWaves[n].bFinished || m_vWaves[n].bFlagForStop)
+			{
+				if (m_vWaves[n].pStream)
+					m_vWaves[n].pStream->m_bPlaying = false;
+				m_qFreedSlots.Push(m_vWaves[n].nSlot);
+				m_vWaves[n] = m_vWaves[--m_nWaves];
+				m_vSlotWave[m_vWaves[n].nSlot] = n;
+			}
+			else
+				n++;
+		}
+	}
+
+	void WaveEngine::SetOutputVolume(const float fVolume)
+	{
+		m_fOutputVolume = std::clamp(fVolume, 0.0f, 1.0f);
+	}
+
+	void WaveEngine::MixWaves(float* pOut, const uint32_t nFrames)
+	{
+		for (uint32_t nWave = 0; nWave < m_nWaves; nWave++)
+		{
+			WaveInstance& wave = m_vWaves[nWave];
+
+			// Streams keep their own place in the file, and loop by themselves
+			if (wave.pStream)
+			{
+				if (wave.bFlagForStop || wave.pStream->MixInto(pOut, m_nChannels, nFrames, wave.dSpeedModifier) < nFrames)
+					wave.bFinished = true;
+				continue;
+			}
+
+			const double dEnd = double(wave.pWave->file.samples());
+			const double dStep = wave.dSpeedModifier;
+			const wave::Resampler& resampler = m_vResamplers[size_t(wave.eQuality)];
+
+			uint32_t nFrame = 0;
+			while (nFrame < nFrames && !wave.bFinished)
+			{
+				// Is wave instance flagged for stopping?
+				if (wave.bFlagForStop)
+				{
+					wave.bFinished = true;
+					break;
+				}
+
+				// Frames left before the position is past the end of the wave
+				uint32_t nLive = 0;
+				if (wave.dPosition < dEnd && dStep > 0.0)
+				{
+					nLive = uint32_t(std::min(double(nFrames - nFrame), std::ceil((dEnd - wave.dPosition) / dStep)));
+					while (nLive > 0 && wave.dPosition + (nLive - 1) * dStep >= dEnd)
+						nLive--;
+				}
+
+				if (nLive == 0)
+				{
+					if (wave.bLoop && dEnd > 0.0 && dStep > 0.0)
+						// ...if looping, go round again, keeping the fraction
+						wave.dPosition = std::fmod(wave.dPosition, dEnd);
+					else
+						// ...if not looping, flag wave instance as dead
+						wave.bFinished = true;
+					continue;
+				}
+
+				// OR, sample the waveform from the correct channel. At unity speed and
+				// whole samples View::MixInto() copies, whatever the quality
+				const bool bCopy = dStep == 1.0 && wave.dPosition == std::floor(wave.dPosition);
+				for (uint32_t nChannel = 0; nChannel < m_nChannels; nChannel++)
+				{
+					const auto& view = wave.pWave->vChannelView[nChannel % wave.pWave->file.channels()];
+					float* pChannel = pOut + nFrame * m_nChannels + nChannel;
+					if (bCopy || wave.eQuality == wave::Quality::Linear)
+						view.MixInto(pChannel, m_nChannels, wave.dPosition, dStep, nLive);
+					else
+						resampler.MixInto(view, pChannel, m_nChannels, wave.dPosition, dStep, nLive);
+				}
+				wave.dPosition += nLive * dStep;
+				nFrame += nLive;
+			}
+		}
+	}
+
+	uint32_t WaveEngine::FillOutputBuffer(std::vector<float>& vBuffer, const uint32_t nBufferOffset, const uint32_t nRequiredSamples)
+	{
+		// Drivers may ask for more than the engine was set up for, so work through
+		// it a block at a time rather than grow m_vBlock on the audio thread
+		const uint32_t nBlock = uint32_t(m_vBlock.size() / std::max<uint32_t>(m_nChannels, 1));
+		float* pOut = vBuffer.data() + nBufferOffset;
+		uint32_t nDone = 0;
+		while (nDone < nRequiredSamples && nBlock > 0)
+		{
+			const uint32_t nFrames = std::min(nBlock, nRequiredSamples - nDone);
+			FillBlock(pOut + size_t(nDone) * m_nChannels, nFrames);
+			nDone += nFrames;
+		}
+		return nDone;
 	}
 
-	void WaveEngine::StopWaveform(const PlayingWave& w)
-	{
-		w->bFlagForStop = true;
-	}
+	void WaveEngine::FillBlock(float* pOut, const uint32_t nRequiredSamples)
+	{
+		// Should ReleaseStream() be busy with the waves they sit this block out,
+		// the audio thread must never wait on the game thread
+		const bool bWaves = !m_bWavesBusy.exchange(true, std::memory_order_acquire);
+		if (bWaves)
+		{
+			m_dWavesTime = m_dGlobalTime;
+			ApplyWaveCommands();
+		}
+
+		const size_t nCount = size_t(nRequiredSamples) * m_nChannels;
+
+		// 1) Sample any active waves
+		std::fill(pOut, pOut + nCount, 0.0f);
+		if (bWaves)
+			MixWaves(pOut, nRequiredSamples);
+
+		// 2) If user is synthesizing, request a block and then samples
+		if (m_funcSynthBlock)
+		{
+			std::fill(m_vBlock.begin(), m_vBlock.begin() + nCount, 0.0f);
+			m_funcSynthBlock(m_vBlock.data(), m_nChannels, nRequiredSamples, m_dGlobalTime, m_dTimePerSample);
+			if (m_eSynthLayout == BlockLayout::Interleaved)
+			{
+				for (size_t n = 0; n < nCount; n++)
+					pOut[n] += m_vBlock[n];
+			}
+			else
+			{
+				for (uint32_t nChannel = 0; nChannel < m_nChannels; nChannel++)
+					for (uint32_t nSample = 0; nSample < nRequiredSamples; nSample++)
+						pOut[nSample * m_nChannels + nChannel] += m_vBlock[nChannel * nRequiredSamples + nSample];
+			}
+		}
+
+		if (m_funcNewSample || m_funcUserSynth)
+		{
+			for (uint32_t nSample = 0; nSample < nRequiredSamples; nSample++)
+			{
+				double dSampleTime = m_dGlobalTime + nSample * m_dTimePerSample;
+
+				if (m_funcNewSample)
+					m_funcNewSample(dSampleTime);
+
+				if (m_funcUserSynth)
+				{
+					for (uint32_t nChannel = 0; nChannel < m_nChannels; nChannel++)
+						pOut[nSample * m_nChannels + nChannel] += m_funcUserSynth(nChannel, dSampleTime);
+				}
+			}
+		}
+
+		// 3) Apply global filters
+
+
+		// 4) If user is filtering, allow manipulation of output
+		if (m_funcUserFilter)
+		{
+			for (uint32_t nSample = 0; nSample < nRequiredSamples; nSample++)
+			{
+				double dSampleTime = m_dGlobalTime + nSample * m_dTimePerSample;
+				for (uint32_t nChannel = 0; nChannel < m_nChannels; nChannel++)
+				{
+					float& fSample = pOut[nSample * m_nChannels + nChannel];
+					fSample = m_funcUserFilter(nChannel, dSampleTime, fSample);
+				}
+			}
+		}
+
+		if (m_funcFilterBlock)
+		{
+			if (m_eFilterLayout == BlockLayout::Interleaved || m_nChannels == 1)
+			{
+				m_funcFilterBlock(pOut, m_nChannels, nRequiredSamples, m_dGlobalTime, m_dTimePerSample);
+			}
+			else
+			{
+				for (uint32_t nChannel = 0; nChannel < m_nChannels; nChannel++)
+					for (uint32_t nSample = 0; nSample < nRequiredSamples; nSample++)
+						m_vBlock[nChannel * nRequiredSamples + nSample] = pOut[nSample * m_nChannels + nChannel];
+				m_funcFilterBlock(m_vBlock.data(), m_nChannels, nRequiredSamples, m_dGlobalTime, m_dTimePerSample);
+				for (uint32_t nChannel = 0; nChannel < m_nChannels; nChannel++)
+					for (uint32_t nSample = 0; nSample < nRequiredSamples; nSample++)
+						pOut[nSample * m_nChannels + nChannel] = m_vBlock[nChannel * nRequiredSamples + nSample];
+			}
+		}
+
+		// Place samples in buffer, one pass the compiler can vectorise
+		const float fVolume = m_fOutputVolume;
+		for (size_t n = 0; n < nCount; n++)
+			pOut[n] *= fVolume;
+
+		if (bWaves)
+		{
+			RemoveFinishedWaves();
+			m_dWavesTime = m_dGlobalTime + nRequiredSamples * m_dTimePerSample;
+			m_bWavesBusy.store(false, std::memory_order_release);
+		}
+
+		// UPdate global time, accounting for error (thanks scripticuk)
+		m_dGlobalTime += nRequiredSamples * m_dTimePerSample;
+	}
+
+
+	uint32_t WaveEngine::GetSampleRate() const
+	{
+		return m_nSampleRate;
+	}
+
+	uint32_t WaveEngine::GetChannels() const
+	{
+		return m_nChannels;
+	}
+
+	uint32_t WaveEngine::GetBlocks() const
+	{
+		return m_nBlocks;
+	}
+
+	uint32_t WaveEngine::GetBlockSampleCount() const
+	{
+		return m_nBlockSamples;
+	}
+
+	double WaveEngine::GetTimePerSample() const
+	{
+		return m_dTimePerSample;
+	}
+
+	namespace driver
+	{
+		Base::Base(olc::sound::WaveEngine* pHost) : m_pHost(pHost)
+		{}
+
+		Base::~Base()
+		{}
+
+		bool Base::Open(const std::string& sOutputDevice, const std::string& sInputDevice)
+		{
+			return false;
+		}
+
+		bool Base::Start()
+		{
+			return false;
+		}
+
+		void Base::Stop()
+		{
+		}
+
+		void Base::Close()
+		{
+		}
+
+		std::vector<std::string> Base::EnumerateOutputDevices()
+		{
+			return { "DEFAULT" };
+		}
+
+		std::vector<std::string> Base::EnumerateInputDevices()
+		{
+			return { "NONE" };
+		}
+
+		void Base::ProcessOutputBlock(std::vector<float>& vFloatBuffer, std::vector<short>& vDACBuffer)
+		{
+			constexpr float fMaxSample = float(std::numeric_limits<short>::max());
+			constexpr float fMinSample = float(std::numeric_limits<short>::min());
+
+			// So... why not use vFloatBuffer.size()? Well with this implementation
+			// we can, but i suspect there may be some platforms that request a
+			// specific number of samples per "loop" rather than this block architecture
+			uint32_t nSamplesToProcess = m_pHost->GetBlockSampleCount();
+			uint32_t nSampleOffset = 0;
+			while (nSamplesToProcess > 0)
+			{
+				uint32_t nSamplesGathered = m_pHost->FillOutputBuffer(vFloatBuffer, nSampleOffset, nSamplesToProcess);
+
+				// Vector is in float32 format, so convert to hardware required format
+				for (uint32_t n = 0; n < nSamplesGathered; n++)
+				{
+					for (uint32_t c = 0; c < m_pHost->GetChannels(); c++)
+					{
+						size_t nSampleID = nSampleOffset + (n * m_pHost->GetChannels() + c);
+						vDACBuffer[nSampleID] = short(std::clamp(vFloatBuffer[nSampleID] * fMaxSample, fMinSample, fMaxSample));
+					}
+				}
+
+				nSampleOffset += nSamplesGathered;
+				nSamplesToProcess -= nSamplesGathered;
+			}
+		}
+
+		void Base::GetFullOutputBlock(std::vector<float>& vFloatBuffer)
+		{
+			uint32_t nSamplesToProcess = m_pHost->GetBlockSampleCount();
+			uint32_t nSampleOffset = 0;
+			while (nSamplesToProcess > 0)
+			{
+				uint32_t nSamplesGathered = m_pHost->FillOutputBuffer(vFloatBuffer, nSampleOffset, nSamplesToProcess);
+
+				nSampleOffset += nSamplesGathered;
+				nSamplesToProcess -= nSamplesGathered;
+			}
+		}
+	}
+
+	namespace synth
+	{
+		template<typename T>
+		Property_generic<T>::Property_generic(double f, Rate eRate)
+		{
+			value = T(f);
+			rate = eRate;
+		}
+
+		template<typename T>
+		Property_generic<T>::Property_generic(const Property_generic& p)
+		{
+			value = p.value;
+			rate = p.rate;
+		}
+
+		template<typename T>
+		Property_generic<T>& Property_generic<T>::operator =(const double f)
+		{
+			value = T(f);
+			return *this;
+		}
+
+		template<typename T>
+		Property_generic<T>& Property_generic<T>::operator =(const Property_generic& p)
+		{
+			value = p.value;
+			return *this;
+		}
+
+
+		template<typename T>
+		void Module_generic<T>::ProcessBlock(uint32_t nChannel, double dStartTime, double dTimeStep, uint32_t nFrames)
+		{
+			for (uint32_t n = 0; n < nFrames; n++)
+			{
+				for (auto& pInput : m_vInputs)
+				{
+					if (pInput->buffer != nullptr)
+						pInput->value = pInput->buffer[n];
+				}
+
+				Update(nChannel, dStartTime + n * dTimeStep, dTimeStep);
+
+				for (auto& pOutput : m_vOutputs)
+				{
+					if (pOutput->buffer != nullptr)
+						pOutput->buffer[n] = pOutput->value;
+				}
+			}
+		}
+
+		template<typename T>
+		void Module_generic<T>::HandleEvent(uint32_t nEvent, double dValue)
+		{
+		}
+
+		template<typename T>
+		void Module_generic<T>::HandleEventAt(uint32_t nEvent, double dValue, uint32_t nFrame)
+		{
+			HandleEvent(nEvent, dValue);
+		}
+
+		template<typename T>
+		void Module_generic<T>::Reset()
+		{
+		}
+
+		template<typename T>
+		const std::vector<Property_generic<T>*>& Module_generic<T>::GetInputs() const
+		{
+			return m_vInputs;
+		}
+
+		template<typename T>
+		const std::vector<Property_generic<T>*>& Module_generic<T>::GetOutputs() const
+		{
+			return m_vOutputs;
+		}
+
+		template<typename T>
+		void Module_generic<T>::RegisterInput(Property* pProperty)
+		{
+			m_vInputs.push_back(pProperty);
+		}
+
+		template<typename T>
+		void Module_generic<T>::RegisterOutput(Property* pProperty)
+		{
+			m_vOutputs.push_back(pProperty);
+		}
+
+
+		WorkerPool::WorkerPool(uint32_t nThreads)
+		{
+			m_nThreads = std::max(nThreads, 1u);
+			m_pQueues = std::make_unique<Queue[]>(m_nThreads);
+			for (uint32_t i = 1; i < m_nThreads; i++)
+				m_vThreads.emplace_back(&WorkerPool::Worker, this, i);
+		}
+
+		WorkerPool::~WorkerPool()
+		{
+			{
+				std::lock_guard<std::mutex> lock(m_muxWake);
+				m_bQuit = true;
+				m_nEpoch++;
+			}
+			m_cvWake.notify_all();
+
+			for (auto& thread : m_vThreads)
+				thread.join();
+		}
+
+		void WorkerPool::Reserve(size_t nTasks)
+		{
+			if (nTasks <= m_nCapacity)
+				return;
+
+			// Every task is pushed exactly once per Run(), so no queue ever needs more
+			for (uint32_t i = 0; i < m_nThreads; i++)
+			{
+				Queue& q = m_pQueues[i];
+				while (q.bLock.test_and_set(std::memory_order_acquire))
+					std::this_thread::yield();
+				q.vTasks.resize(nTasks);
+				q.bLock.clear(std::memory_order_release);
+			}
+
+			m_pWaitsOn = std::make_unique<std::atomic<uint32_t>[]>(nTasks);
+			m_nCapacity = nTasks;
+		}
+
+		void WorkerPool::Run(const std::vector<std::vector<uint32_t>>& vNext, const std::vector<uint32_t>& vWaitsOn, void (*pfnTask)(void*, uint32_t), void* pContext)
+		{
+			const size_t nTasks = vNext.size();
+			if (nTasks == 0)
+				return;
+
+			Reserve(nTasks);
+
+			m_pvNext = &vNext;
+			m_pfnTask = pfnTask;
+			m_pContext = pContext;
+			for (size_t i = 0; i < nTasks; i++)
+				m_pWaitsOn[i].store(vWaitsOn[i], std::memory_order_relaxed);
+			m_nRemaining.store(nTasks, std::memory_order_relaxed);
+
+			for (uint32_t i = 0; i < m_nThreads; i++)
+			{
+				Queue& q = m_pQueues[i];
+				while (q.bLock.test_and_set(std::memory_order_acquire))
+					std::this_thread::yield();
+				q.nHead = q.nTail = 0;
+				q.bLock.clear(std::memory_order_release);
+			}
+
+			// Spread the tasks that can start straight away over all the queues
+			uint32_t nQueue = 0;
+			for (size_t i = 0; i < nTasks; i++)
+			{
+				if (vWaitsOn[i] == 0)
+				{
+					Push(nQueue, uint32_t(i));
+					nQueue = (nQueue + 1) % m_nThreads;
+				}
+			}
+
+			// Dekker style handshake with Worker(): either it sees the new epoch, or
+			// we see it is about to sleep and wake it
+			m_nEpoch.fetch_add(1);
+			if (m_nSleeping.load() > 0)
+			{
+				std::lock_guard<std::mutex> lock(m_muxWake);
+				m_cvWake.notify_all();
+			}
+
+			while (m_nRemaining.load(std::memory_order_acquire) > 0)
+			{
+				if (!Execute(0))
+					std::this_thread::yield();
+			}
+		}
+
+		uint32_t WorkerPool::GetThreads() const
+		{
+			return m_nThreads;
+		}
+
+		void WorkerPool::Worker(uint32_t nQueue)
+		{
+			ScopedFlushDenormals flush;
+			uint64_t nSeen = 0;
+			while (true)
+			{
+				// Blocks follow each other closely, so spin for a little while
+				// before going to sleep
+				uint32_t nSpins = 0;
+				while (m_nEpoch.load() == nSeen)
+				{
+					if (++nSpins < 256)
+					{
+						std::this_thread::yield();
+						continue;
+					}
+
+					std::unique_lock<std::mutex> lock(m_muxWake);
+					m_nSleeping.fetch_add(1);
+					m_cvWake.wait(lock, [&] { return m_nEpoch.load() != nSeen; });
+					m_nSleeping.fetch_sub(1);
+				}
+
+				nSeen = m_nEpoch.load();
+				if (m_bQuit)
+					return;
+
+				while (m_nRemaining.load(std::memory_order_acquire) > 0)
+				{
+					if (!Execute(nQueue))
+						std::this_thread::yield();
+				}
+			}
+		}
+
+		bool WorkerPool::Execute(uint32_t nQueue)
+		{
+			// Newest task from our own queue first, it follows on from what we just
+			// ran, otherwise the oldest from someone else's
+			uint32_t nTask = 0;
+			bool bFound = Pop(nQueue, nTask, false);
+			for (uint32_t i = 1; i < m_nThreads && !bFound; i++)
+				bFound = Pop((nQueue + i) % m_nThreads, nTask, true);
+
+			if (!bFound)
+				return false;
+
+			m_pfnTask(m_pContext, nTask);
+
+			for (auto nNext : (*m_pvNext)[nTask])
+			{
+				if (m_pWaitsOn[nNext].fetch_sub(1, std::memory_order_acq_rel) == 1)
+					Push(nQueue, nNext);
+			}
+
+			m_nRemaining.fetch_sub(1, std::memory_order_release);
+			return true;
+		}
+
+		void WorkerPool::Push(uint32_t nQueue, uint32_t nTask)
+		{
+			Queue& q = m_pQueues[nQueue];
+			while (q.bLock.test_and_set(std::memory_order_acquire))
+				std::this_thread::yield();
+			q.vTasks[q.nTail++] = nTask;
+			q.bLock.clear(std::memory_order_release);
+		}
+
+		bool WorkerPool::Pop(uint32_t nQueue, uint32_t& nTask, bool bSteal)
+		{
+			Queue& q = m_pQueues[nQueue];
+			while (q.bLock.test_and_set(std::memory_order_acquire))
+				std::this_thread::yield();
+
+			bool bFound = q.nHead != q.nTail;
+			if (bFound)
+				nTask = bSteal ? q.vTasks[q.nHead++] : q.vTasks[--q.nTail];
+
+			q.bLock.clear(std::memory_order_release);
+			return bFound;
+		}
+
+
+		template<typename T>
+		ModularSynth_generic<T>::ModularSynth_generic()
+		{
+			// Sized once so holding back future events never allocates
+			m_vPendingEvents.reserve(256);
+		}
+
+		template<typename T>
+		bool ModularSynth_generic<T>::AddModule(Module* pModule)
+		{
+			// Check if module already added
+			if (std::find(m_vModules.begin(), m_vModules.end(), pModule) == std::end(m_vModules))
+			{
+				m_vModules.push_back(pModule);
+				m_bDirty = true;
+				return true;
+			}
+
+			return false;
+		}
+
+		template<typename T>
+		bool ModularSynth_generic<T>::RemoveModule(Module* pModule)
+		{
+			if (std::find(m_vModules.begin(), m_vModules.end(), pModule) != std::end(m_vModules))
+			{
+				m_vModules.erase(std::remove(m_vModules.begin(), m_vModules.end(), pModule), m_vModules.end());
+				m_vControlRate.erase(std::remove_if(m_vControlRate.begin(), m_vControlRate.end(), [&](const ControlRate& c) { return c.pModule == pModule; }), m_vControlRate.end());
+				m_bDirty = true;
+				return true;
+			}
+
+			return false;
+		}
+
+		template<typename T>
+		bool ModularSynth_generic<T>::AddPatch(Property* pInput, Property* pOutput)
+		{
+			// Does patch exist?
+			std::pair<Property*, Property*> newPatch = std::pair<Property*, Property*>(pInput, pOutput);
+
+			if (std::find(m_vPatches.begin(), m_vPatches.end(), newPatch) == std::end(m_vPatches))
+			{
+				// Patch doesnt exist, now check if either are null
+				if (pInput != nullptr && pOutput != nullptr)
+				{
+					m_vPatches.push_back(newPatch);
+					m_bDirty = true;
+					return true;
+				}
+			}
+
+			return false;
+		}
+
+		template<typename T>
+		bool ModularSynth_generic<T>::RemovePatch(Property* pInput, Property* pOutput)
+		{
+			std::pair<Property*, Property*> newPatch = std::pair<Property*, Property*>(pInput, pOutput);
+
+			if (std::find(m_vPatches.begin(), m_vPatches.end(), newPatch) != std::end(m_vPatches))
+			{
+				m_vPatches.erase(std::remove(m_vPatches.begin(), m_vPatches.end(), newPatch), m_vPatches.end());
+				m_bDirty = true;
+				return true;
+			}
+
+			return false;
+		}
+
+		template<typename T>
+		bool ModularSynth_generic<T>::AddOutput(Property* pOutput)
+		{
+			if (pOutput != nullptr && std::find(m_vOutputs.begin(), m_vOutputs.end(), pOutput) == std::end(m_vOutputs))
+			{
+				m_vOutputs.push_back(pOutput);
+				m_bDirty = true;
+				return true;
+			}
+
+			return false;
+		}
+
+		template<typename T>
+		bool ModularSynth_generic<T>::SetControlRate(Module* pModule, uint32_t nPeriod, Interpolation eInterpolation)
+		{
+			if (std::find(m_vModules.begin(), m_vModules.end(), pModule) == std::end(m_vModules))
+				return false;
+
+			auto it = std::find_if(m_vControlRate.begin(), m_vControlRate.end(), [&](const ControlRate& c) { return c.pModule == pModule; });
+			if (nPeriod <= 1)
+			{
+				if (it != m_vControlRate.end())
+					m_vControlRate.erase(it);
+			}
+			else
+			{
+				if (it == m_vControlRate.end())
+					it = m_vControlRate.insert(m_vControlRate.end(), ControlRate());
+				it->pModule = pModule;
+				it->nPeriod = nPeriod;
+				it->eInterpolation = eInterpolation;
+				it->nLeft = 0;
+				it->nDone = 0;
+				it->bPrimed = false;
+			}
+
+			m_bDirty = true;
+			return true;
+		}
+
+		template<typename T>
+		void ModularSynth_generic<T>::UpdatePatches()
+		{
+			// Update patches
+			for (auto& patch : m_vPatches)
+			{
+				patch.second->value = patch.first->value;
+			}
+		}
+
+
+		template<typename T>
+		void ModularSynth_generic<T>::Update(uint32_t nChannel, double dTime, double dTimeStep)
+		{
+			// A single sample is just a very small block
+			ProcessBlock(nChannel, dTime, dTimeStep, 1);
+		}
+
+		template<typename T>
+		void ModularSynth_generic<T>::Compile(uint32_t nMaxFrames)
+		{
+			// Forget any previous bindings, the graph may have changed
+			for (auto& pProperty : m_vBound)
+				pProperty->buffer = nullptr;
+			m_vBound.clear();
+			m_vPlan.clear();
+			m_vSteps.clear();
+			m_vFeedback.clear();
+			m_vControl.clear();
+			m_vLoosePatches.clear();
+
+			// Find out which module owns each port
+			const size_t nModules = m_vModules.size();
+			std::unordered_map<Property*, size_t> mapInputOwner;
+			std::unordered_map<Property*, size_t> mapOutputOwner;
+			for (size_t i = 0; i < nModules; i++)
+			{
+				for (auto& pInput : m_vModules[i]->GetInputs()) mapInputOwner[pInput] = i;
+				for (auto& pOutput : m_vModules[i]->GetOutputs()) mapOutputOwner[pOutput] = i;
+			}
+
+			// Module level dependencies, one edge per patch between declared ports
+			std::vector<std::vector<size_t>> vEdges(nModules);
+			for (auto& patch : m_vPatches)
+			{
+				auto itSource = mapOutputOwner.find(patch.first);
+				auto itTarget = mapInputOwner.find(patch.second);
+				if (itSource != mapOutputOwner.end() && itTarget != mapInputOwner.end())
+					vEdges[itSource->second].push_back(itTarget->second);
+				else
+					m_vLoosePatches.push_back(patch);
+			}
+
+			// Group modules that feed back into each other (Tarjan's algorithm), as
+			// nothing inside such a loop can be computed a whole block ahead
+			std::vector<size_t> vGroup(nModules, nModules);
+			std::vector<size_t> vIndex(nModules, nModules);
+			std::vector<size_t> vLowLink(nModules, 0);
+			std::vector<bool> vOnStack(nModules, false);
+			std::vector<size_t> vStack;
+			size_t nIndex = 0;
+			size_t nGroups = 0;
+
+			std::function<void(size_t)> Visit = [&](size_t v)
+			{
+				vIndex[v] = vLowLink[v] = nIndex++;
+				vStack.push_back(v);
+				vOnStack[v] = true;
+
+				for (auto w : vEdges[v])
+				{
+					if (vIndex[w] == nModules)
+					{
+						Visit(w);
+						vLowLink[v] = std::min(vLowLink[v], vLowLink[w]);
+					}
+					else if (vOnStack[w])
+						vLowLink[v] = std::min(vLowLink[v], vIndex[w]);
+				}
+
+				if (vLowLink[v] == vIndex[v])
+				{
+					size_t w;
+					do
+					{
+						w = vStack.back();
+						vStack.pop_back();
+						vOnStack[w] = false;
+						vGroup[w] = nGroups;
+					} while (w != v);
+					nGroups++;
+				}
+			};
+
+			for (size_t i = 0; i < nModules; i++)
+			{
+				if (vIndex[i] == nModules)
+					Visit(i);
+			}
+
+			// Order the groups so producers run before consumers. Ties keep the order
+			// modules were added in, so independent modules behave as they always have.
+			std::vector<std::vector<size_t>> vMembers(nGroups);
+			for (size_t i = 0; i < nModules; i++)
+				vMembers[vGroup[i]].push_back(i);
+
+			std::vector<size_t> vFirstMember(nGroups);
+			for (size_t g = 0; g < nGroups; g++)
+				vFirstMember[g] = vMembers[g][0];
+
+			std::vector<size_t> vDependencies(nGroups, 0);
+			std::vector<bool> vSelfLoop(nGroups, false);
+			std::vector<size_t> vLoopInputs(nModules, 0);
+			std::vector<bool> vFedFromOutside(nModules, false);
+			for (size_t i = 0; i < nModules; i++)
+			{
+				for (auto j : vEdges[i])
+				{
+					if (vGroup[i] != vGroup[j])
+					{
+						vDependencies[vGroup[j]]++;
+						vFedFromOutside[j] = true;
+					}
+					else if (i == j)
+						vSelfLoop[vGroup[i]] = true;
+					else
+						vLoopInputs[j]++;
+				}
+			}
+
+			// Inside a loop, start where signal enters it and follow the patches
+			// round, so as few patches as possible end up delayed
+			for (auto& vLoop : vMembers)
+			{
+				std::vector<size_t> vOrdered;
+				while (!vLoop.empty())
+				{
+					auto itNext = std::min_element(vLoop.begin(), vLoop.end(), [&](size_t a, size_t b)
+					{
+						if (vLoopInputs[a] != vLoopInputs[b]) return vLoopInputs[a] < vLoopInputs[b];
+						if (vFedFromOutside[a] != vFedFromOutside[b]) return bool(vFedFromOutside[a]);
+						return a < b;
+					});
+
+					size_t i = *itNext;
+					vLoop.erase(itNext);
+					vOrdered.push_back(i);
+					for (auto j : vEdges[i])
+					{
+						if (vGroup[j] == vGroup[i] && j != i && vLoopInputs[j] > 0)
+							vLoopInputs[j]--;
+					}
+				}
+				vLoop = vOrdered;
+			}
+
+			std::vector<bool> vScheduled(nGroups, false);
+			std::vector<size_t> vPlanIndex(nModules, 0);
+			for (size_t nScheduled = 0; nScheduled < nGroups; nScheduled++)
+			{
+				size_t nNext = nGroups;
+				for (size_t g = 0; g < nGroups; g++)
+				{
+					if (!vScheduled[g] && vDependencies[g] == 0 && (nNext == nGroups || vFirstMember[g] < vFirstMember[nNext]))
+						nNext = g;
+				}
+
+				vScheduled[nNext] = true;
+				for (auto i : vMembers[nNext])
+				{
+					for (auto j : vEdges[i])
+					{
+						if (vGroup[j] != nNext)
+							vDependencies[vGroup[j]]--;
+					}
+				}
+
+				Step step;
+				step.nFirst = m_vPlan.size();
+				step.nCount = vMembers[nNext].size();
+				step.bLoop = step.nCount > 1 || vSelfLoop[nNext];
+				for (auto i : vMembers[nNext])
+				{
+					vPlanIndex[i] = m_vPlan.size();
+					m_vPlan.push_back(m_vModules[i]);
+				}
+				m_vSteps.push_back(step);
+			}
+
+			// Outputs patched to audio rate inputs and requested synth outputs own a
+			// buffer. An output that only drives control rate inputs just keeps its value
+			auto Bind = [&](Property* pProperty)
+			{
+				if (std::find(m_vBound.begin(), m_vBound.end(), pProperty) == std::end(m_vBound))
+					m_vBound.push_back(pProperty);
+			};
+
+			for (auto& patch : m_vPatches)
+			{
+				if (mapOutputOwner.count(patch.first) > 0 && mapInputOwner.count(patch.second) > 0 && patch.second->rate == Property::Rate::Audio)
+					Bind(patch.first);
+			}
+
+			for (auto& pOutput : m_vOutputs)
+			{
+				if (mapOutputOwner.count(pOutput) > 0)
+					Bind(pOutput);
+			}
+
+			m_nBlockCapacity = std::max(m_nBlockCapacity, nMaxFrames);
+			m_vBlockMemory.assign(m_vBound.size() * m_nBlockCapacity, 0.0);
+			for (size_t i = 0; i < m_vBound.size(); i++)
+				m_vBound[i]->buffer = m_vBlockMemory.data() + i * m_nBlockCapacity;
+
+			// Inputs read their source's buffer directly, no copying. The exception is
+			// a patch that points backwards within a loop: that one reads the value the
+			// source produced on the previous frame, an explicit one sample delay.
+			// Control rate inputs take the last value of their source once per block.
+			std::vector<std::vector<std::pair<Property*, Property*>>> vFeedback(m_vPlan.size());
+			std::vector<std::vector<std::pair<Property*, Property*>>> vControl(m_vPlan.size());
+			for (auto& patch : m_vPatches)
+			{
+				auto itSource = mapOutputOwner.find(patch.first);
+				auto itTarget = mapInputOwner.find(patch.second);
+				if (itSource == mapOutputOwner.end() || itTarget == mapInputOwner.end())
+					continue;
+
+				if (patch.second->rate == Property::Rate::Control)
+				{
+					vControl[vPlanIndex[itTarget->second]].push_back(patch);
+				}
+				else if (vPlanIndex[itSource->second] >= vPlanIndex[itTarget->second])
+				{
+					vFeedback[vPlanIndex[itTarget->second]].push_back(patch);
+				}
+				else
+				{
+					patch.second->buffer = patch.first->buffer;
+					m_vBound.push_back(patch.second);
+				}
+			}
+
+			m_vFeedbackStart.assign(m_vPlan.size() + 1, 0);
+			for (size_t i = 0; i < m_vPlan.size(); i++)
+			{
+				m_vFeedbackStart[i] = m_vFeedback.size();
+				m_vFeedback.insert(m_vFeedback.end(), vFeedback[i].begin(), vFeedback[i].end());
+			}
+			m_vFeedbackStart[m_vPlan.size()] = m_vFeedback.size();
+
+			m_vControlStart.assign(m_vPlan.size() + 1, 0);
+			for (size_t i = 0; i < m_vPlan.size(); i++)
+			{
+				m_vControlStart[i] = m_vControl.size();
+				m_vControl.insert(m_vControl.end(), vControl[i].begin(), vControl[i].end());
+			}
+			m_vControlStart[m_vPlan.size()] = m_vControl.size();
+
+			// Steps that depend on each other, for running the plan in parallel
+			std::vector<size_t> vStepOf(m_vPlan.size());
+			for (size_t nStep = 0; nStep < m_vSteps.size(); nStep++)
+			{
+				for (size_t i = m_vSteps[nStep].nFirst; i < m_vSteps[nStep].nFirst + m_vSteps[nStep].nCount; i++)
+					vStepOf[i] = nStep;
+			}
+
+			std::vector<std::vector<size_t>> vStepNext(m_vSteps.size());
+			std::vector<size_t> vStepWaitsOn(m_vSteps.size(), 0);
+			for (size_t i = 0; i < nModules; i++)
+			{
+				for (auto j : vEdges[i])
+				{
+					size_t a = vStepOf[vPlanIndex[i]];
+					size_t b = vStepOf[vPlanIndex[j]];
+					if (a != b && std::find(vStepNext[a].begin(), vStepNext[a].end(), b) == vStepNext[a].end())
+					{
+						vStepNext[a].push_back(b);
+						vStepWaitsOn[b]++;
+					}
+				}
+			}
+
+			// Control rate modules, unless they sit in a feedback loop
+			m_vPlanControlRate.assign(m_vPlan.size(), m_vControlRate.size());
+			for (size_t c = 0; c < m_vControlRate.size(); c++)
+			{
+				auto itPlan = std::find(m_vPlan.begin(), m_vPlan.end(), m_vControlRate[c].pModule);
+				size_t i = size_t(itPlan - m_vPlan.begin());
+				if (itPlan == m_vPlan.end() || m_vSteps[vStepOf[i]].bLoop)
+					continue;
+
+				m_vPlanControlRate[i] = c;
+				const size_t nOutputs = m_vControlRate[c].pModule->GetOutputs().size();
+				if (m_vControlRate[c].vHistory.size() != nOutputs)
+				{
+					m_vControlRate[c].vHistory.assign(nOutputs, {});
+					m_vControlRate[c].vCurve.assign(nOutputs, {});
+					m_vControlRate[c].bPrimed = false;
+				}
+			}
+
+			// A step that is the only thing feeding the next one joins its task, so
+			// chains run on one thread without a hand over between every module
+			const size_t nNoTask = m_vSteps.size();
+			std::vector<size_t> vTaskOf(m_vSteps.size(), nNoTask);
+			m_vTaskSteps.clear();
+			m_vTaskStart.clear();
+			for (size_t nStep = 0; nStep < m_vSteps.size(); nStep++)
+			{
+				if (vTaskOf[nStep] != nNoTask)
+					continue;
+
+				const size_t nTask = m_vTaskStart.size();
+				m_vTaskStart.push_back(m_vTaskSteps.size());
+				size_t nChain = nStep;
+				while (true)
+				{
+					vTaskOf[nChain] = nTask;
+					m_vTaskSteps.push_back(nChain);
+					if (vStepNext[nChain].size() != 1 || vStepWaitsOn[vStepNext[nChain][0]] != 1)
+						break;
+					nChain = vStepNext[nChain][0];
+				}
+			}
+			m_vTaskStart.push_back(m_vTaskSteps.size());
+
+			const size_t nTasks = m_vTaskStart.size() - 1;
+			m_vTaskNext.assign(nTasks, {});
+			m_vTaskWaitsOn.assign(nTasks, 0);
+			for (size_t a = 0; a < m_vSteps.size(); a++)
+			{
+				for (auto b : vStepNext[a])
+				{
+					auto& vNext = m_vTaskNext[vTaskOf[a]];
+					if (vTaskOf[a] != vTaskOf[b] && std::find(vNext.begin(), vNext.end(), uint32_t(vTaskOf[b])) == vNext.end())
+					{
+						vNext.push_back(uint32_t(vTaskOf[b]));
+						m_vTaskWaitsOn[vTaskOf[b]]++;
+					}
+				}
+			}
+
+			if (m_pWorkers)
+				m_pWorkers->Reserve(nTasks);
+
+			m_bDirty = false;
+		}
+
+		template<typename T>
+		void ModularSynth_generic<T>::ProcessBlock(uint32_t nChannel, double dStartTime, double dTimeStep, uint32_t nFrames)
+		{
+			// Only recompiles when the graph changes or a larger block turns up
+			if (m_bDirty || nFrames > m_nBlockCapacity)
+				Compile(std::max(nFrames, m_nBlockCapacity));
+
+			m_dTime.store(dStartTime, std::memory_order_relaxed);
+			ApplyEvents(dStartTime, dTimeStep, nFrames);
+
+			for (auto& patch : m_vLoosePatches)
+				patch.second->value = patch.first->value;
+
+			if (m_pWorkers && m_vTaskNext.size() > 1)
+			{
+				m_nBlockChannel = nChannel;
+				m_dBlockStart = dStartTime;
+				m_dBlockStep = dTimeStep;
+				m_nBlockFrames = nFrames;
+				m_pWorkers->Run(m_vTaskNext, m_vTaskWaitsOn, &ModularSynth_generic<T>::RunTask, this);
+				return;
+			}
 
-	void WaveEngine::StopAll()
-	{
-		for (auto& wave : m_listWaves)
-		{
-			wave.bFlagForStop = true;
+			for (size_t nStep = 0; nStep < m_vSteps.size(); nStep++)
+				RunStep(nStep, nChannel, dStartTime, dTimeStep, nFrames);
 		}
-	}
 
-	void WaveEngine::SetOutputVolume(const float fVolume)
-	{
-		m_fOutputVolume = std::clamp(fVolume, 0.0f, 1.0f);
-	}
+		template<typename T>
+		void ModularSynth_generic<T>::SetThreads(uint32_t nThreads)
+		{
+#if defined(__EMSCRIPTEN__)
+			// No threads without -pthread, and the browser's audio callback could not wait on them anyway
+			nThreads = 1;
+#endif
+			if (nThreads <= 1)
+				m_pWorkers.reset();
+			else if (!m_pWorkers || m_pWorkers->GetThreads() != nThreads)
+				m_pWorkers = std::make_unique<WorkerPool>(nThreads);
 
-	uint32_t WaveEngine::FillOutputBuffer(std::vector<float>& vBuffer, const uint32_t nBufferOffset, const uint32_t nRequiredSamples)
-	{
-		for (uint32_t nSample = 0; nSample < nRequiredSamples; nSample++)
+			m_bDirty = true;
+		}
+
+		template<typename T>
+		void ModularSynth_generic<T>::RunStep(size_t nStep, uint32_t nChannel, double dStartTime, double dTimeStep, uint32_t nFrames)
 		{
-			double dSampleTime = m_dGlobalTime + nSample * m_dTimePerSample;
+			// Control rate inputs hold one value for the whole block, sources earlier
+			// in the plan have already finished it, later ones give their last block's
+			const Step& step = m_vSteps[nStep];
+			for (size_t f = m_vControlStart[step.nFirst]; f < m_vControlStart[step.nFirst + step.nCount]; f++)
+				m_vControl[f].second->value = m_vControl[f].first->value;
+
+			if (step.bLoop)
+				ProcessLoop(nStep, nChannel, dStartTime, dTimeStep, nFrames);
+			else if (m_vPlanControlRate[step.nFirst] < m_vControlRate.size())
+				RunControlRate(m_vPlanControlRate[step.nFirst], nChannel, dStartTime, dTimeStep, nFrames);
+			else
+				m_vPlan[step.nFirst]->ProcessBlock(nChannel, dStartTime, dTimeStep, nFrames);
+		}
 
-			if (m_funcNewSample)
-				m_funcNewSample(dSampleTime);
+		template<typename T>
+		void ModularSynth_generic<T>::RunControlRate(size_t nControl, uint32_t nChannel, double dStartTime, double dTimeStep, uint32_t nFrames)
+		{
+			ControlRate& c = m_vControlRate[nControl];
+			const auto& vInputs = c.pModule->GetInputs();
+			const auto& vOutputs = c.pModule->GetOutputs();
+			const T fScale = T(1) / T(c.nPeriod);
 
-			for (uint32_t nChannel = 0; nChannel < m_nChannels; nChannel++)
+			uint32_t n = 0;
+			while (n < nFrames)
 			{
-				// Construct the sample
-				float fSample = 0.0f;
-
-				// 1) Sample any active waves
-				for (auto& wave : m_listWaves)
+				if (c.nLeft == 0)
 				{
-					// Is wave instance flagged for stopping?
-					if (wave.bFlagForStop)
+					for (auto& pInput : vInputs)
 					{
-						wave.bFinished = true;
+						if (pInput->buffer != nullptr)
+							pInput->value = pInput->buffer[n];
 					}
-					else
+
+					c.pModule->Update(nChannel, dStartTime + n * dTimeStep, dTimeStep * c.nPeriod);
+
+					for (size_t o = 0; o < vOutputs.size(); o++)
 					{
-						// Calculate offset into wave instance
-						double dTimeOffset = dSampleTime - wave.dInstanceTime;
+						auto& h = c.vHistory[o];
+						const T f = vOutputs[o]->value;
+						if (c.bPrimed)
+							h = { h[1], h[2], h[3], f };
+						else
+							h = { f, f, f, f };
 
-						// If offset is larger than wave then...
-						if (dTimeOffset >= wave.dDuration)
+						if (c.eInterpolation == Interpolation::Cubic)
 						{
-							if (wave.bLoop)
-							{
-								// ...if looping, reset the wave instance
-								wave.dInstanceTime = dSampleTime;
-							}
-							else
-							{
-								// ...if not looping, flag wave instance as dead
-								wave.bFinished = true;
-							}
+							// Catmull-Rom from h[1] to h[2]
+							c.vCurve[o] = {
+								T(0.5) * (-h[0] + T(3) * h[1] - T(3) * h[2] + h[3]),
+								h[0] - T(2.5) * h[1] + T(2) * h[2] - T(0.5) * h[3],
+								T(0.5) * (h[2] - h[0]),
+								h[1] };
 						}
 						else
 						{
-							// OR, sample the waveform from the correct channel
-							fSample += float(wave.pWave->vChannelView[nChannel % wave.pWave->file.channels()].GetSample(dTimeOffset * m_dSamplePerTime * wave.dSpeedModifier));
+							// Straight from h[2] to h[3]
+							c.vCurve[o] = { T(0), T(0), h[3] - h[2], h[2] };
 						}
 					}
-				}
 
-				// Remove waveform instances that have finished
-				m_listWaves.remove_if([](const WaveInstance& wi) {return wi.bFinished; });
-
-
-				// 2) If user is synthesizing, request sample
-				if (m_funcUserSynth)
-					fSample += m_funcUserSynth(nChannel, dSampleTime);
-
-				// 3) Apply global filters
+					c.bPrimed = true;
+					c.nLeft = c.nPeriod;
+					c.nDone = 0;
+				}
 
+				const uint32_t nRun = std::min(c.nLeft, nFrames - n);
+				for (size_t o = 0; o < vOutputs.size(); o++)
+				{
+					const auto& k = c.vCurve[o];
+					auto Curve = [&](uint32_t nFrame) { const T x = T(nFrame) * fScale; return ((k[0] * x + k[1]) * x + k[2]) * x + k[3]; };
 
-				// 4) If user is filtering, allow manipulation of output
-				if (m_funcUserFilter)
-					fSample = m_funcUserFilter(nChannel, dSampleTime, fSample);
+					T* pBuffer = vOutputs[o]->buffer;
+					if (pBuffer != nullptr)
+					{
+						for (uint32_t i = 0; i < nRun; i++)
+							pBuffer[n + i] = Curve(c.nDone + i);
+					}
+					// Control rate inputs fed from here see the curve too
+					vOutputs[o]->value = Curve(c.nDone + nRun - 1);
+				}
 
-				// Place sample in buffer
-				vBuffer[nBufferOffset + nSample * m_nChannels + nChannel] = fSample * m_fOutputVolume;
+				n += nRun;
+				c.nLeft -= nRun;
+				c.nDone += nRun;
 			}
 		}
 
-		// UPdate global time, accounting for error (thanks scripticuk)
-		m_dGlobalTime += nRequiredSamples * m_dTimePerSample;
-		return nRequiredSamples;
-	}
-
-
-	uint32_t WaveEngine::GetSampleRate() const
-	{
-		return m_nSampleRate;
-	}
-
-	uint32_t WaveEngine::GetChannels() const
-	{
-		return m_nChannels;
-	}
-
-	uint32_t WaveEngine::GetBlocks() const
-	{
-		return m_nBlocks;
-	}
-
-	uint32_t WaveEngine::GetBlockSampleCount() const
-	{
-		return m_nBlockSamples;
-	}
-
-	double WaveEngine::GetTimePerSample() const
-	{
-		return m_dTimePerSample;
-	}
-
-	namespace driver
-	{
-		Base::Base(olc::sound::WaveEngine* pHost) : m_pHost(pHost)
-		{}
+		template<typename T>
+		void ModularSynth_generic<T>::RunTask(void* pSynth, uint32_t nTask)
+		{
+			ModularSynth_generic<T>* s = static_cast<ModularSynth_generic<T>*>(pSynth);
+			for (size_t i = s->m_vTaskStart[nTask]; i < s->m_vTaskStart[nTask + 1]; i++)
+				s->RunStep(s->m_vTaskSteps[i], s->m_nBlockChannel, s->m_dBlockStart, s->m_dBlockStep, s->m_nBlockFrames);
+		}
 
-		Base::~Base()
-		{}
+		template<typename T>
+		bool ModularSynth_generic<T>::PostValue(Property* pTarget, double dValue, double dTime)
+		{
+			return PostValue(&pTarget->value, dValue, dTime);
+		}
 
-		bool Base::Open(const std::string& sOutputDevice, const std::string& sInputDevice)
+		template<typename T>
+		bool ModularSynth_generic<T>::PostValue(T* pTarget, double dValue, double dTime)
 		{
-			return false;
+			Event e;
+			e.dTime = dTime;
+			e.pTarget = pTarget;
+			e.dValue = dValue;
+			return m_qEvents.Push(e);
 		}
 
-		bool Base::Start()
+		template<typename T>
+		bool ModularSynth_generic<T>::PostEvent(Module* pModule, uint32_t nEvent, double dValue, double dTime)
 		{
-			return false;
+			Event e;
+			e.dTime = dTime;
+			e.pModule = pModule;
+			e.nEvent = nEvent;
+			e.dValue = dValue;
+			return m_qEvents.Push(e);
 		}
 
-		void Base::Stop()
+		template<typename T>
+		size_t ModularSynth_generic<T>::EventSpace() const
 		{
+			return m_qEvents.Free();
 		}
 
-		void Base::Close()
+		template<typename T>
+		double ModularSynth_generic<T>::GetTime() const
 		{
+			return m_dTime.load(std::memory_order_relaxed);
 		}
 
-		std::vector<std::string> Base::EnumerateOutputDevices()
+		template<typename T>
+		void ModularSynth_generic<T>::ApplyEvents(double dStartTime, double dTimeStep, uint32_t nFrames)
 		{
-			return { "DEFAULT" };
+			const double dUntil = dStartTime + nFrames * dTimeStep;
+
+			// Frame of this block an event falls on, anything in the past is due now
+			auto Frame = [&](const Event& e)
+			{
+				if (e.dTime <= dStartTime || nFrames == 0)
+					return uint32_t(0);
+				return std::min(uint32_t((e.dTime - dStartTime) / dTimeStep), nFrames - 1);
+			};
+
+			// Events held back from earlier blocks go first, keeping posting order
+			auto itKeep = m_vPendingEvents.begin();
+			for (auto& e : m_vPendingEvents)
+			{
+				if (e.dTime < dUntil)
+					ApplyEvent(e, Frame(e));
+				else
+					*itKeep++ = e;
+			}
+			m_vPendingEvents.erase(itKeep, m_vPendingEvents.end());
+
+			Event e;
+			while (m_qEvents.Pop(e))
+			{
+				// If there is no room to wait, applying early beats losing the event
+				if (e.dTime >= dUntil && m_vPendingEvents.size() < m_vPendingEvents.capacity())
+					m_vPendingEvents.push_back(e);
+				else
+					ApplyEvent(e, Frame(e));
+			}
 		}
 
-		std::vector<std::string> Base::EnumerateInputDevices()
+		template<typename T>
+		void ModularSynth_generic<T>::ApplyEvent(const Event& e, uint32_t nFrame)
 		{
-			return { "NONE" };
+			// Values land at the start of the block, modules may do better
+			if (e.pTarget != nullptr)
+				*e.pTarget = T(e.dValue);
+
+			if (e.pModule != nullptr)
+				e.pModule->HandleEventAt(e.nEvent, e.dValue, nFrame);
 		}
 
-		void Base::ProcessOutputBlock(std::vector<float>& vFloatBuffer, std::vector<short>& vDACBuffer)
+		template<typename T>
+		void ModularSynth_generic<T>::ProcessLoop(size_t nStep, uint32_t nChannel, double dStartTime, double dTimeStep, uint32_t nFrames)
 		{
-			constexpr float fMaxSample = float(std::numeric_limits<short>::max());
-			constexpr float fMinSample = float(std::numeric_limits<short>::min());
+			const Step& step = m_vSteps[nStep];
 
-			// So... why not use vFloatBuffer.size()? Well with this implementation
-			// we can, but i suspect there may be some platforms that request a
-			// specific number of samples per "loop" rather than this block architecture
-			uint32_t nSamplesToProcess = m_pHost->GetBlockSampleCount();
-			uint32_t nSampleOffset = 0;
-			while (nSamplesToProcess > 0)
+			for (uint32_t n = 0; n < nFrames; n++)
 			{
-				uint32_t nSamplesGathered = m_pHost->FillOutputBuffer(vFloatBuffer, nSampleOffset, nSamplesToProcess);
+				double dTime = dStartTime + n * dTimeStep;
 
-				// Vector is in float32 format, so convert to hardware required format
-				for (uint32_t n = 0; n < nSamplesGathered; n++)
+				for (size_t i = step.nFirst; i < step.nFirst + step.nCount; i++)
 				{
-					for (uint32_t c = 0; c < m_pHost->GetChannels(); c++)
+					Module* pModule = m_vPlan[i];
+
+					for (auto& pInput : pModule->GetInputs())
 					{
-						size_t nSampleID = nSampleOffset + (n * m_pHost->GetChannels() + c);
-						vDACBuffer[nSampleID] = short(std::clamp(vFloatBuffer[nSampleID] * fMaxSample, fMinSample, fMaxSample));
+						if (pInput->buffer != nullptr)
+							pInput->value = pInput->buffer[n];
 					}
-				}
 
-				nSampleOffset += nSamplesGathered;
-				nSamplesToProcess -= nSamplesGathered;
+					// Sources later in the loop still hold last frame's value
+					for (size_t f = m_vFeedbackStart[i]; f < m_vFeedbackStart[i + 1]; f++)
+						m_vFeedback[f].second->value = m_vFeedback[f].first->value;
+
+					pModule->Update(nChannel, dTime, dTimeStep);
+
+					for (auto& pOutput : pModule->GetOutputs())
+					{
+						if (pOutput->buffer != nullptr)
+							pOutput->buffer[n] = pOutput->value;
+					}
+				}
 			}
 		}
 
-		void Base::GetFullOutputBlock(std::vector<float>& vFloatBuffer)
+
+		NoiseGenerator::NoiseGenerator(uint32_t nSeed, uint32_t nStream)
 		{
-			uint32_t nSamplesToProcess = m_pHost->GetBlockSampleCount();
-			uint32_t nSampleOffset = 0;
-			while (nSamplesToProcess > 0)
-			{
-				uint32_t nSamplesGathered = m_pHost->FillOutputBuffer(vFloatBuffer, nSampleOffset, nSamplesToProcess);
+			Seed(nSeed, nStream);
+		}
 
-				nSampleOffset += nSamplesGathered;
-				nSamplesToProcess -= nSamplesGathered;
-			}
+		void NoiseGenerator::Seed(uint32_t nSeed, uint32_t nStream)
+		{
+			m_nCounter = nSeed;
+			m_nKey = Hash(nStream, 0);
 		}
-	}
 
-	namespace synth
-	{
-		Property::Property(double f)
+		uint32_t NoiseGenerator::Hash(uint32_t n, uint32_t nKey)
 		{
-			value = std::clamp(f, -1.0, 1.0);
+			// Two rounds of xorshift and multiply, only 32 bit operations, which
+			// SSE2 and up have for 4 or 8 lanes at once
+			n ^= nKey;
+			n ^= n >> 16;
+			n *= 0x7feb352d;
+			n ^= n >> 15;
+			n *= 0x846ca68b;
+			n ^= n >> 16;
+			return n;
 		}
 
-		Property& Property::operator =(const double f)
+		uint32_t NoiseGenerator::Next()
 		{
-			value = std::clamp(f, -1.0, 1.0);
-			return *this;
+			m_nCounter += 0xe120fc15;
+			return Hash(m_nCounter, m_nKey);
 		}
 
+		void NoiseGenerator::Fill(uint32_t* pData, size_t nCount)
+		{
+			// Every value is independent, so with the state in locals that pData
+			// cannot alias, the compiler vectorises the hash over each chunk
+			const uint32_t nKey = m_nKey;
+			uint32_t nBase = m_nCounter;
+			size_t n = 0;
+			for (; n + m_nChunk <= nCount; n += m_nChunk)
+			{
+				uint32_t* pChunk = pData + n;
+				for (size_t i = 0; i < m_nChunk; i++)
+					pChunk[i] = Hash(nBase + uint32_t(i + 1) * 0xe120fc15, nKey);
+				nBase += uint32_t(m_nChunk) * 0xe120fc15;
+			}
+			m_nCounter = nBase;
+			for (; n < nCount; n++)
+				pData[n] = Next();
+		}
 
-		ModularSynth::ModularSynth()
+		double NoiseGenerator::ToUniform(uint32_t n, double dScale, double dMin)
 		{
+			// Flipping the top bit makes the value signed, which converts to
+			// double in one instruction where unsigned does not
+			return (double(int32_t(n ^ 0x80000000)) + 2147483648.0) * dScale + dMin;
+		}
 
+		double NoiseGenerator::NextUniform(double dMin, double dMax)
+		{
+			return ToUniform(Next(), (dMax - dMin) / 4294967296.0, dMin);
 		}
 
-		bool ModularSynth::AddModule(Module* pModule)
+		void NoiseGenerator::FillUniform(double* pData, size_t nCount, double dMin, double dMax)
 		{
-			// Check if module already added
-			if (std::find(m_vModules.begin(), m_vModules.end(), pModule) == std::end(m_vModules))
+			uint32_t nBits[m_nChunk] = {};
+			double dValues[m_nChunk];
+			const double dScale = (dMax - dMin) / 4294967296.0;
+			for (size_t n = 0; n < nCount; n += m_nChunk)
 			{
-				m_vModules.push_back(pModule);
-				return true;
+				size_t nFrames = std::min(m_nChunk, nCount - n);
+				Fill(nBits, nFrames);
+				// Always the whole chunk, the fixed length lets this vectorise too
+				for (size_t i = 0; i < m_nChunk; i++)
+					dValues[i] = ToUniform(nBits[i], dScale, dMin);
+				std::copy(dValues, dValues + nFrames, pData + n);
 			}
-
-			return false;
 		}
 
-		bool ModularSynth::RemoveModule(Module* pModule)
+		void NoiseGenerator::FillGaussian(double* pData, size_t nCount, double dSigma)
 		{
-			if (std::find(m_vModules.begin(), m_vModules.end(), pModule) == std::end(m_vModules))
+			// Box-Muller, every pair of uniform values gives a pair of normal ones
+			FillUniform(pData, nCount, 0.0, 1.0);
+			for (size_t n = 0; n < nCount; n += 2)
 			{
-				m_vModules.erase(std::remove(m_vModules.begin(), m_vModules.end(), pModule), m_vModules.end());
-				return true;
+				double u = n + 1 < nCount ? pData[n + 1] : NextUniform(0.0, 1.0);
+				double r = dSigma * std::sqrt(-2.0 * std::log(1.0 - pData[n]));
+				double a = 2.0 * 3.14159265358979323846 * u;
+				pData[n] = r * std::cos(a);
+				if (n + 1 < nCount) pData[n + 1] = r * std::sin(a);
 			}
-
-			return false;
 		}
 
-		bool ModularSynth::AddPatch(Property* pInput, Property* pOutput)
+
+		Wavetable::Wavetable(const std::function<double(double)>& fShape)
 		{
-			// Does patch exist?
-			std::pair<Property*, Property*> newPatch = std::pair<Property*, Property*>(pInput, pOutput);
+			// Fourier series of the shape, with sin and cos read from one table
+			// since every angle is a whole multiple of 2 pi / m_nSize
+			std::vector<double> vShape(m_nSize), vCos(m_nSize), vSin(m_nSize);
+			for (size_t i = 0; i < m_nSize; i++)
+			{
+				vShape[i] = fShape(double(i) / m_nSize);
+				vCos[i] = std::cos(2.0 * 3.14159265358979323846 * i / m_nSize);
+				vSin[i] = std::sin(2.0 * 3.14159265358979323846 * i / m_nSize);
+			}
 
-			if (std::find(m_vPatches.begin(), m_vPatches.end(), newPatch) == std::end(m_vPatches))
+			double dMean = 0.0;
+			for (double d : vShape) dMean += d;
+			dMean /= m_nSize;
+
+			std::vector<double> vA(m_nHarmonics + 1, 0.0), vB(m_nHarmonics + 1, 0.0);
+			for (size_t h = 1; h <= m_nHarmonics; h++)
 			{
-				// Patch doesnt exist, now check if either are null
-				if (pInput != nullptr && pOutput != nullptr)
+				for (size_t i = 0; i < m_nSize; i++)
 				{
-					m_vPatches.push_back(newPatch);
-					return true;
+					vA[h] += vShape[i] * vCos[(h * i) % m_nSize];
+					vB[h] += vShape[i] * vSin[(h * i) % m_nSize];
 				}
+				vA[h] *= 2.0 / m_nSize;
+				vB[h] *= 2.0 / m_nSize;
 			}
 
-			return false;
-		}
-
-		bool ModularSynth::RemovePatch(Property* pInput, Property* pOutput)
-		{
-			std::pair<Property*, Property*> newPatch = std::pair<Property*, Property*>(pInput, pOutput);
-
-			if (std::find(m_vPatches.begin(), m_vPatches.end(), newPatch) == std::end(m_vPatches))
+			// Each level down adds the harmonics the one above it left out
+			m_vTable.resize(m_nLevels * (m_nSize + 1));
+			std::vector<double> vSum(m_nSize, dMean);
+			size_t nHarmonics = 0;
+			for (size_t l = m_nLevels; l-- > 0;)
 			{
-				m_vPatches.erase(std::remove(m_vPatches.begin(), m_vPatches.end(), newPatch), m_vPatches.end());
-				return true;
-			}
+				size_t nLimit = m_nHarmonics >> l;
+				for (size_t h = nHarmonics + 1; h <= nLimit; h++)
+				{
+					for (size_t i = 0; i < m_nSize; i++)
+						vSum[i] += vA[h] * vCos[(h * i) % m_nSize] + vB[h] * vSin[(h * i) % m_nSize];
+				}
+				nHarmonics = nLimit;
 
-			return false;
+				float* pLevel = &m_vTable[l * (m_nSize + 1)];
+				for (size_t i = 0; i < m_nSize; i++)
+					pLevel[i] = float(vSum[i]);
+				pLevel[m_nSize] = pLevel[0];
+			}
 		}
 
-		void ModularSynth::UpdatePatches()
+		double Wavetable::Wrap(double t)
 		{
-			// Update patches
-			for (auto& patch : m_vPatches)
-			{
-				patch.second->value = patch.first->value;
-			}
+			t -= double(int64_t(t));
+			return t < 0.0 ? t + 1.0 : t;
 		}
 
-
-		void ModularSynth::Update(uint32_t nChannel, double dTime, double dTimeStep)
+		double Wavetable::Sample(double t, double dt) const
 		{
-			// Now update synth
-			for (auto& pModule : m_vModules)
-			{
-				pModule->Update(nChannel, dTime, dTimeStep);
-			}
+			// Harmonic h sits at h * dt cycles per sample
+			double dMax = 0.5 / std::max(std::abs(dt), 1e-9);
+			size_t l = 0;
+			while (l + 1 < m_nLevels && double(m_nHarmonics >> l) > dMax) l++;
+
+			double dPos = Wrap(t) * m_nSize;
+			size_t i = std::min(size_t(dPos), m_nSize - 1);
+			double dFrac = dPos - double(i);
+			const float* pLevel = &m_vTable[l * (m_nSize + 1)];
+			return pLevel[i] + (pLevel[i + 1] - pLevel[i]) * dFrac;
 		}
 
 
 		namespace modules
 		{
-			void Oscillator::Update(uint32_t nChannel, double dTime, double dTimeStep)
+			template<typename T>
+			Oscillator_generic<T>::Oscillator_generic()
+			{
+				this->RegisterInput(&frequency);
+				this->RegisterInput(&amplitude);
+				this->RegisterInput(&lfo_input);
+				this->RegisterInput(&parameter);
+				this->RegisterOutput(&output);
+
+				// Build the shared tables here rather than on the audio thread
+				SineTable();
+				TriangleTable();
+			}
+
+			template<typename T>
+			void Oscillator_generic<T>::Update(uint32_t nChannel, double dTime, double dTimeStep)
 			{
 				// We use phase accumulation to combat change in parameter glitches
 				double w = frequency.value * max_frequency * dTimeStep;
-				phase_acc += w + lfo_input.value * frequency.value;
+				double dStep = w + lfo_input.value * frequency.value;
+				phase_acc += dStep;
 				if (phase_acc >= 2.0) phase_acc -= 2.0;
 
+				// The noise range runs past 1 and is meant to be clipped
+				if (waveform == Type::Noise)
+					output = std::clamp(T(amplitude.value * noise.NextUniform(noise_min, noise_max)), T(-1), T(1));
+				else
+					output = amplitude.value * Shape(nChannel, dStep, parameter.value);
+			}
+
+			template<typename T>
+			void Oscillator_generic<T>::ProcessBlock(uint32_t nChannel, double dStartTime, double dTimeStep, uint32_t nFrames)
+			{
+				if (waveform == Type::Noise)
+				{
+					double dNoise[64];
+					for (uint32_t nStart = 0; nStart < nFrames; nStart += 64)
+					{
+						uint32_t nCount = std::min<uint32_t>(64, nFrames - nStart);
+						noise.FillUniform(dNoise, nCount, noise_min, noise_max);
+						for (uint32_t i = 0; i < nCount; i++)
+						{
+							uint32_t n = nStart + i;
+							// Keep the phase moving as Update() does, for a change of waveform
+							phase_acc += frequency[n] * max_frequency * dTimeStep + lfo_input[n] * frequency[n];
+							if (phase_acc >= 2.0) phase_acc -= 2.0;
+							output.Write(n, std::clamp(T(amplitude[n] * dNoise[i]), T(-1), T(1)));
+						}
+					}
+					return;
+				}
+
+				if (waveform == Type::Sine && frequency.buffer == nullptr && lfo_input.buffer == nullptr)
+				{
+					// At a steady pitch each sample is the last one rotated by the
+					// same angle, so a complex multiply replaces the lookup. The
+					// phasor restarts from phase_acc every block, so it never drifts
+					double dStep = frequency.value * max_frequency * dTimeStep + lfo_input.value * frequency.value;
+					double dAngle = 2.0 * 3.14159265358979323846 * (phase_acc + dStep);
+					double dRotate = 2.0 * 3.14159265358979323846 * dStep;
+					double dRe = std::cos(dAngle), dIm = std::sin(dAngle);
+					const double dRotRe = std::cos(dRotate), dRotIm = std::sin(dRotate);
+					for (uint32_t n = 0; n < nFrames; n++)
+					{
+						phase_acc += dStep;
+						if (phase_acc >= 2.0) phase_acc -= 2.0;
+						output.Write(n, amplitude[n] * dIm);
+						double dNext = dRe * dRotRe - dIm * dRotIm;
+						dIm = dRe * dRotIm + dIm * dRotRe;
+						dRe = dNext;
+					}
+					return;
+				}
+
+				if (waveform == Type::Wave)
+				{
+					Module_generic<T>::ProcessBlock(nChannel, dStartTime, dTimeStep, nFrames);
+					return;
+				}
+
+				for (uint32_t n = 0; n < nFrames; n++)
+				{
+					double dStep = frequency[n] * max_frequency * dTimeStep + lfo_input[n] * frequency[n];
+					phase_acc += dStep;
+					if (phase_acc >= 2.0) phase_acc -= 2.0;
+					output.Write(n, amplitude[n] * Shape(nChannel, dStep, parameter[n]));
+				}
+			}
+
+			template<typename T>
+			double Oscillator_generic<T>::Shape(uint32_t nChannel, double dStep, double dParameter) const
+			{
+				// The shapes with a period of 2 units of phase_acc
+				double t = Wavetable::Wrap(phase_acc * 0.5);
+				double dt = std::abs(dStep) * 0.5;
+
 				switch (waveform)
 				{
 				case Type::Sine:
-					output = amplitude.value * sin(phase_acc * 2.0 * 3.14159);
-					break;
+					return SineTable().Sample(phase_acc, dStep);
 
 				case Type::Saw:
-					output = amplitude.value * (phase_acc - 1.0) * 2.0;
-					break;
+					return 2.0 * t - 1.0 - PolyBlep(t, dt);
 
 				case Type::Square:
-					output = amplitude.value * (phase_acc >= 1.0) ? 1.0 : -1.0;
-					break;
+				{
+					double dEdge = t + 0.5;
+					return (t >= 0.5 ? 1.0 : -1.0) - PolyBlep(t, dt) + PolyBlep(Wavetable::Wrap(dEdge), dt);
+				}
 
 				case Type::Triangle:
-					output = amplitude.value * (phase_acc < 1.0) ? (phase_acc * 0.5) : (1.0 - phase_acc * 0.5);
-					break;
+					return TriangleTable().Sample(t, dt);
 
 				case Type::PWM:
-					output = amplitude.value * (phase_acc >= (parameter.value + 1.0)) ? 1.0 : -1.0;
-					break;
+				{
+					// High once phase_acc passes parameter + 1
+					double dRise = std::clamp((dParameter + 1.0) * 0.5, 0.0, 1.0);
+					double dEdge = t - dRise + 1.0;
+					return (t >= dRise ? 1.0 : -1.0) - PolyBlep(t, dt) + PolyBlep(Wavetable::Wrap(dEdge), dt);
+				}
 
 				case Type::Wave:
 					if (pWave != nullptr)
-						output = amplitude.value * pWave->vChannelView[nChannel].GetSample(phase_acc * 0.5 * pWave->file.durationInSamples());
-					break;
+						return pWave->vChannelView[nChannel].GetSample(phase_acc * 0.5 * pWave->file.durationInSamples());
+					return 0.0;
 
-				case Type::Noise:
-					output = amplitude.value * rndDouble(-1.0, 1.0);
-					break;
+				default:
+					return 0.0;
+				}
+			}
 
+			template<typename T>
+			double Oscillator_generic<T>::PolyBlep(double t, double dt)
+			{
+				// A step of 2 rising at t = 0, less the naive step, as a polynomial
+				// over the sample either side
+				if (t < dt)
+				{
+					t /= dt;
+					return t + t - t * t - 1.0;
+				}
+				if (t > 1.0 - dt)
+				{
+					t = (t - 1.0) / dt;
+					return t * t + t + t + 1.0;
 				}
+				return 0.0;
 			}
 
-			double Oscillator::rndDouble(double min, double max)
+			template<typename T>
+			const Wavetable& Oscillator_generic<T>::SineTable()
 			{
-				return ((double)rnd() / (double)(0x7FFFFFFF)) * (max - min) + min;
+				static const Wavetable table([](double t) { return std::sin(2.0 * 3.14159265358979323846 * t); });
+				return table;
 			}
 
-			uint32_t Oscillator::rnd()
+			template<typename T>
+			const Wavetable& Oscillator_generic<T>::TriangleTable()
 			{
-				random_seed += 0xe120fc15;
-				uint64_t tmp;
-				tmp = (uint64_t)random_seed * 0x4a39b70d;
-				uint32_t m1 = uint32_t(((tmp >> 32) ^ tmp) & 0xFFFFFFFF);
-				tmp = (uint64_t)m1 * 0x12fad5c9;
-				uint32_t m2 = uint32_t(((tmp >> 32) ^ tmp) & 0xFFFFFFFF);
-				return m2;
+				// Rises from 0 to 0.5 and back once per period
+				static const Wavetable table([](double t) { return t < 0.5 ? t : 1.0 - t; });
+				return table;
+			}
+
+			template<typename T>
+			void Oscillator_generic<T>::Seed(uint32_t nSeed, uint32_t nStream)
+			{
+				noise.Seed(nSeed, nStream);
 			}
 		}
+
+		template class Property_generic<float>;
+		template class Property_generic<double>;
+		template class Module_generic<float>;
+		template class Module_generic<double>;
+		template class ModularSynth_generic<float>;
+		template class ModularSynth_generic<double>;
+		template class modules::Oscillator_generic<float>;
+		template class modules::Oscillator_generic<double>;
 	}
 }
 
@@ -1496,6 +4503,8 @@ namespace olc::sound::driver
 
 	void WinMM::DriverLoop()
 	{
+		ScopedFlushDenormals flush;
+
 		// We will be using this vector to transfer to the host for filling, with 
 		// user sound data (float32, -1.0 --> +1.0)
 		std::vector<float> vFloatBuffer(m_pHost->GetBlockSampleCount() * m_pHost->GetChannels(), 0.0f);
@@ -1662,7 +4671,11 @@ namespace olc::sound::driver
 		if (!instance->m_keepRunning)
 			return;
 
-		instance->GetFullOutputBlock(userData);
+		// SDL owns this thread, so only hold the mode while rendering
+		{
+			ScopedFlushDenormals flush;
+			instance->GetFullOutputBlock(userData);
+		}
 		instance->FillChunkBuffer(userData);
 
 		if (Mix_PlayChannel(0, &instance->audioChunk, 0) == -1)
@@ -1797,6 +4810,7 @@ namespace olc::sound::driver
 
 	void ALSA::DriverLoop()
 	{
+		ScopedFlushDenormals flush;
 		const uint32_t nFrames = m_pHost->GetBlockSampleCount();
 
 		int err;
@@ -1936,6 +4950,8 @@ namespace olc::sound::driver
 
 	void PulseAudio::DriverLoop()
 	{
+		ScopedFlushDenormals flush;
+
 		// We will be using this vector to transfer to the host for filling, with
 		// user sound data (float32, -1.0 --> +1.0)
 		std::vector<float> vFloatBuffer(m_pHost->GetBlockSampleCount() * m_pHost->GetChannels(), 0.0f);
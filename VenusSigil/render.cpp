@@ -0,0 +1,129 @@
+//Offline renderer for the thunder patch
+//
+//Plays a fixed, seeded sequence of bolts through the game's sound without
+//an audio device, as fast as the CPU allows, streams the result to a WAV
+//file and reports how much faster than real time it ran.
+//
+//Build with offline_render_build.sh, then run
+//	venus_sigil_render [output.wav] [seconds] [seed]
+//It renders the double precision graph, add -DSOUNDWAVE_SYNTH_FLOAT to the
+//build to hear the float graph the game runs.
+#define OLC_SOUNDWAVE
+#define SOUNDWAVE_USING_OFFLINE
+#include "olcSoundWaveEngine.h"
+
+#include "ThunderPatch.h"
+
+#include <chrono>
+#include <iostream>
+
+//Same rhythm as the game at the start: a bolt is built, hinted
+//at for a second, then strikes and shows for a while
+const double bolt_period = 4.0;
+const double hint_time = 1.0;
+const double release_time = 1.3;
+
+//Regression check: a voice left idle keeps its strike silent, the strike
+//must still crack however long it waited.  Returns the loudest the strike
+//got in its first second
+double IdleStrikePeak(double idle_seconds)
+{
+	auto thunder = std::make_unique<ThunderPatch>();
+	const uint32_t frames = 512;
+	const double step = 1.0 / samplerate;
+	std::vector<float> buffer(frames);
+
+	double now = 0.0;
+	auto run = [&](double seconds) {
+		for (double end = now + seconds; now < end; now += frames * step) {
+			thunder->GetBlock(buffer.data(), 1, frames, now, step);
+		}
+	};
+
+	run(idle_seconds);
+	thunder->Prepare(0.5f, release_time);
+	thunder->Strike();
+	run(1.0);
+
+	double peak = 0.0;
+	for (auto& voice : thunder->voices) {
+		peak = std::max(peak, voice.ls.max_mag);
+	}
+	return peak;
+}
+
+int main(int argc, char* argv[])
+{
+	std::string filename = argc > 1 ? argv[1] : "thunder.wav";
+	double seconds = argc > 2 ? std::atof(argv[2]) : 30.0;
+	unsigned int seed = argc > 3 ? std::atoi(argv[3]) : 1;
+
+	srand(seed);
+
+	olc::sound::WaveEngine engine;
+	engine.InitialiseOffline(samplerate, 1, 512);
+
+	auto thunder = std::make_unique<ThunderPatch>();
+	engine.SetCallBack_SynthBlock([&](float* buffer, uint32_t channels, uint32_t frames, double dTime, double dTimeStep) {
+		thunder->GetBlock(buffer, channels, frames, dTime, dTimeStep);
+	});
+
+	//Each chunk is written as soon as it is rendered, so memory stays the
+	//same however long the render
+	const uint64_t total_frames = static_cast<uint64_t>(seconds * samplerate);
+	const uint32_t chunk_frames = 512;
+	olc::sound::wave::FileWriter<float> file;
+	if (!file.Open(filename, 1, 2, samplerate)) {
+		std::cerr << "Could not write " << filename << "\n";
+		return 1;
+	}
+	std::vector<float> chunk;
+
+	double next_prepare = 0.0;
+	double next_strike = hint_time;
+
+	auto start = std::chrono::steady_clock::now();
+
+	for (uint64_t done = 0; done < total_frames; done += chunk_frames) {
+		double now = static_cast<double>(done) / samplerate;
+
+		//Events are posted between chunks, exactly as the game thread would
+		if (now >= next_prepare) {
+			thunder->Prepare(rand_float(), release_time);
+			next_prepare += bolt_period;
+		}
+		if (now >= next_strike) {
+			thunder->Strike();
+			next_strike += bolt_period;
+		}
+
+		uint32_t frames = static_cast<uint32_t>(std::min<uint64_t>(chunk_frames, total_frames - done));
+		engine.RenderOffline(chunk, frames);
+		if (!file.Write(chunk.data(), frames)) {
+			std::cerr << "Could not write " << filename << "\n";
+			return 1;
+		}
+	}
+
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+	double idle_strike_peak = IdleStrikePeak(10.0);
+
+	if (!file.Close()) {
+		std::cerr << "Could not write " << filename << "\n";
+		return 1;
+	}
+
+	std::cout << "file=" << filename
+		<< " audio_seconds=" << seconds
+		<< " render_seconds=" << elapsed.count()
+		<< " realtime_factor=" << seconds / elapsed.count()
+		<< " nan_blocks=" << thunder->NanEvents()
+		<< " idle_strike_peak=" << idle_strike_peak << "\n";
+
+	if (idle_strike_peak <= 0.0) {
+		std::cerr << "A strike after a long idle was silent\n";
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,4 @@
+#!/bin/sh
+
+# Headless build of the DSP benchmark, needs no audio device or graphics libraries
+g++ -std=c++17 -O2 VenusSigil/bench.cpp -I VenusSigil -o venus_sigil_bench -lpthread
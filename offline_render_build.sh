@@ -0,0 +1,4 @@
+#!/bin/sh
+
+# Headless build of the offline renderer, needs no audio device or graphics libraries
+g++ -std=c++17 -O2 VenusSigil/render.cpp -I VenusSigil -o venus_sigil_render -lpthread